@@ -176,7 +176,10 @@ void ic_style_close(void);
 
 /// Enable history.
 /// Use a \a NULL filename to not persist the history. Use -1 for max_entries to
-/// get the default (200).
+/// get the default (200). The completions the user accepts are recorded (per
+/// command word) in a file next to it, with a `.rank` extension, and the
+/// completion menu and hints rank the completions accepted most often and
+/// most recently first.
 void ic_set_history(const char* fname, long max_entries);
 
 /// Remove the last entry in the history.
@@ -223,6 +226,60 @@ typedef void(ic_completer_fun_t)(ic_completion_env_t* cenv, const char* prefix);
 /// the previous one. The initial completer use `ic_complete_filename`.
 void ic_set_default_completer(ic_completer_fun_t* completer, void* arg);
 
+/// Declare that the default completer is _prefix-monotonic_.
+/// A completer is prefix-monotonic if the completions for a longer word are
+/// always exactly those completions for a shorter word that still start
+/// (ignoring ascii case) with the longer word. When set, typing further word
+/// characters narrows the previous completions in place instead of calling
+/// the completer again. Setting a new completer resets this to `false`
+/// (but the initial filename completer is prefix-monotonic).
+/// Returns the previous setting.
+bool ic_set_completer_monotonic(bool monotonic);
+
+/// Register a named completion provider that is called with the default
+/// completer on every completion. Providers run concurrently, each in its own
+/// thread (so they must be thread-safe), and their completions are merged: a
+/// completion that is added more than once is kept from the provider with the
+/// highest `priority` (built-in sources have priority 0 for `"history"`, 1 for
+/// unknown, 2 for `"file"`, 3 for `"plugin"`, and 4 for `"function"`). If
+/// `budget_ms` is positive, a provider that takes longer is cut short: the
+/// completions it added so far are used and any later ones are ignored.
+/// Registering a provider with an existing name replaces it. While providers
+/// are registered, completions are not narrowed (see
+/// ic_set_completer_monotonic()). Returns `true` if the provider was
+/// registered.
+bool ic_add_completion_provider(const char* name, ic_completer_fun_t* completer, void* arg,
+                                int priority, long budget_ms);
+
+/// Remove a completion provider registered with ic_add_completion_provider().
+/// Returns `true` if a provider with that `name` was registered.
+bool ic_remove_completion_provider(const char* name);
+
+/// Limit the wall-clock time of generating completions: `hint_ms` for a hint
+/// and `complete_ms` for completion on tab (both 0, no limit, by default).
+/// Once the time is up, ic_stop_completing() returns `true` and further
+/// completions are ignored. The completions found so far are used and the
+/// completion menu shows that more results are pending (and page-down
+/// completes again). Providers (see ic_add_completion_provider()) are cut
+/// short as well.
+void ic_set_completion_budget(long hint_ms, long complete_ms);
+
+/// Run the default completer in a separate helper process (disabled by
+/// default). Use this for a completer that may block, for example on a hung
+/// network mount or a slow command. The helper is forked on the first
+/// completion and reused afterwards; its completions are streamed back and
+/// added as they arrive. If it takes longer than `timeout_ms` (or 1 second if
+/// `timeout_ms <= 0`), or than the time budget (see ic_set_completion_budget())
+/// if that is shorter, the completions so far are used and the helper is
+/// killed (and forked again on the next completion). As the helper is a copy
+/// of the process when it was forked, the completer does not see later
+/// changes to the program state (except the current directory, which is
+/// passed along with every completion), and state the completer changes is
+/// not seen by the program; setting a new completer, or calling this function
+/// again, forks a fresh helper. Not supported on Windows. Returns the previous
+/// setting.
+bool ic_set_completer_isolated(bool isolated, long timeout_ms);
+
 /// In a completion callback (usually from ic_complete_word()), use this
 /// function to add a completion. (the completion string is copied by isocline
 /// and do not need to be preserved or allocated).
@@ -267,6 +324,104 @@ bool ic_add_completion_ex_with_source(ic_completion_env_t* cenv, const char* com
 /// not add more completions (for improved latency).
 bool ic_add_completions(ic_completion_env_t* cenv, const char* prefix, const char** completions);
 
+/// Add a completion like ic_add_completion_ex(), but without copying the
+/// strings: they are stored by pointer, and the caller guarantees they stay
+/// valid until the current ic_readline() call returns. This avoids an
+/// allocation and copy per completion for long-lived strings, like static
+/// keyword tables or interned command names. Use ic_add_completion_ex() for
+/// temporary buffers.
+///
+/// Returns `true` if the callback should continue trying to find more possible
+/// completions. If `false` is returned, the callback should try to return and
+/// not add more completions (for improved latency).
+bool ic_add_completion_borrowed(ic_completion_env_t* cenv, const char* completion,
+                                const char* display, const char* help);
+
+/// Add all completions of a `NULL` terminated array that start with `prefix`,
+/// like ic_add_completions(), but without copying them (see
+/// ic_add_completion_borrowed()).
+bool ic_add_completions_borrowed(ic_completion_env_t* cenv, const char* prefix,
+                                 const char** completions);
+
+/// A completion for ic_add_completions_n(). The strings are given with an
+/// explicit length and need not be 0 terminated; a negative length means the
+/// string is 0 terminated. The `display` and `help` can be `NULL`.
+typedef struct ic_completion_item_s {
+    const char* replacement;
+    long replacement_len;
+    const char* display;
+    long display_len;
+    const char* help;
+    long help_len;
+} ic_completion_item_t;
+
+/// In a completion callback, add a batch of `count` completions in one call
+/// (all strings are copied). If `prefiltered` is `false`, only items that
+/// match `prefix` are added (as in ic_add_completions()); if `true`, the
+/// caller already filtered the items and `prefix` is ignored. This avoids the
+/// per-item overhead of ic_add_completion_ex() for large candidate sets.
+///
+/// Returns `true` if the callback should continue trying to find more possible
+/// completions. If `false` is returned, the callback should try to return and
+/// not add more completions (for improved latency).
+bool ic_add_completions_n(ic_completion_env_t* cenv, const char* prefix,
+                          const ic_completion_item_t* items, long count, bool prefiltered);
+
+/// A sorted list of words for completing large keyword sets (see
+/// ic_complete_wordlist()).
+typedef struct ic_wordlist_s ic_wordlist_t;
+
+/// Create a word list from a `NULL` terminated array of `words` (that are
+/// copied). The words are sorted (ignoring ascii case) and stored front-coded
+/// once, so completion only visits the words that start with the prefix.
+/// Duplicate words are stored once. Returns `NULL` if out of memory.
+ic_wordlist_t* ic_wordlist_new(const char** words);
+
+/// Free a word list created with ic_wordlist_new().
+void ic_wordlist_free(ic_wordlist_t* wl);
+
+/// In a completion callback, add the words of `wl` that start with `prefix`,
+/// like ic_add_completions() but with a binary search for the matching range
+/// (or a scan of all words if fuzzy completion is enabled). The words are
+/// added in sorted order.
+///
+/// Returns `true` if the callback should continue trying to find more possible
+/// completions. If `false` is returned, the callback should try to return and
+/// not add more completions (for improved latency).
+bool ic_complete_wordlist(ic_completion_env_t* cenv, const char* prefix, const ic_wordlist_t* wl);
+
+/// An immutable on-disk completion dictionary (see ic_dict_write()).
+typedef struct ic_dict_s ic_dict_t;
+
+/// Write a completion dictionary to the file at `path` for a `NULL` terminated
+/// array of `words`. The `displays` and `helps` arrays (with an element for
+/// each word) can be `NULL`, and so can their elements. The file holds the
+/// words sorted (ignoring ascii case) with an index on their first character;
+/// it is written to `path` with a `.tmp` extension first and then renamed, so
+/// processes that have the previous dictionary open are not affected. Use the
+/// `icdict` tool to create a dictionary from a file. This function does not
+/// initialize isocline (or the terminal) and uses the C allocator. Returns
+/// `true` on success.
+bool ic_dict_write(const char* path, const char** words, const char** displays,
+                   const char** helps);
+
+/// Open a completion dictionary written by ic_dict_write(). The file is
+/// memory mapped read-only, so processes that use the same dictionary share
+/// its pages. Returns `NULL` if the file cannot be opened or is invalid.
+ic_dict_t* ic_dict_open(const char* path);
+
+/// Close a dictionary opened with ic_dict_open().
+void ic_dict_close(ic_dict_t* dict);
+
+/// In a completion callback, add the words of `dict` that start with `prefix`
+/// (with their display and help), like ic_complete_wordlist(). The words are
+/// looked up directly in the mapped file.
+///
+/// Returns `true` if the callback should continue trying to find more possible
+/// completions. If `false` is returned, the callback should try to return and
+/// not add more completions (for improved latency).
+bool ic_complete_dict(ic_completion_env_t* cenv, const char* prefix, const ic_dict_t* dict);
+
 /// Complete a filename.
 /// Complete a filename given a semi-colon separated list of root directories
 /// `roots` and semi-colon separated list of possible extensions (excluding
@@ -285,6 +440,17 @@ bool ic_add_completions(ic_completion_env_t* cenv, const char* prefix, const cha
 void ic_complete_filename(ic_completion_env_t* cenv, const char* prefix, char dir_separator,
                           const char* roots, const char* extensions);
 
+/// Complete a command name.
+/// Completes the current word with the names of the executables in the
+/// directories of the `PATH` environment variable. The executables are kept in
+/// a process-wide sorted index so completion does not access the file system;
+/// the `PATH` directories are checked for changes at most once per second (in
+/// the background) and only changed directories are read again. Words that
+/// contain a `/` are not completed (use ic_complete_filename() for those).
+/// (This already uses ic_complete_quoted_word() so do not call it from inside a
+/// word handler).
+void ic_complete_command(ic_completion_env_t* cenv, const char* prefix);
+
 /// Function that returns whether a (utf8) character (of length `len`) is in a
 /// certain character class
 /// @see ic_char_is_separator() etc.
@@ -468,12 +634,65 @@ bool ic_enable_prompt_cleanup_empty_line(bool enable);
 /// @returns the previous setting.
 bool ic_enable_hint(bool enable);
 
+/// Enable or disable completion prefetch (disabled by default). Once the input
+/// is idle for the hint delay (see ic_set_hint_delay()), the completions for
+/// tab are generated in advance so the completion menu shows instantly. The
+/// prefetch is limited to 100ms (or the tab budget of
+/// ic_set_completion_budget() if smaller) and stops once a key is pressed
+/// (checked whenever the completer adds a completion or calls
+/// ic_stop_completing()). Any key press discards the prefetched completions.
+/// @returns the previous setting.
+bool ic_enable_completion_prefetch(bool enable);
+
+/// Disable or enable the directory listing cache of the filename completer
+/// (enabled by default). Directory listings are reused across completions as
+/// long as the directory is unchanged (checked through its inode and
+/// modification time, and through inotify on Linux).
+/// @returns the previous setting.
+bool ic_enable_filename_cache(bool enable);
+
+/// Scan the roots of filename completion concurrently on a small pool of
+/// `threads` threads (at most 16). The default of 0 (or 1) scans the roots
+/// sequentially. The completions are merged in the order of the roots. A root
+/// that is not scanned within `root_timeout_ms` (1000ms by default, ignored
+/// if <= 0) is skipped so a single hung mount cannot block completion.
+/// Returns the previous number of threads.
+long ic_set_filename_threads(long threads, long root_timeout_ms);
+
+/// Limit recursive filename completion. A word with a `**` path component,
+/// like `src/**/ma`, completes `ma` in `src` and in all directories below it
+/// (skipping hidden entries and those matched by `.gitignore` or `.ignore`
+/// files). The walk descends at most `max_depth` directories (16 by default)
+/// and visits at most `max_entries` entries (100000 by default; a value <= 0
+/// leaves the current limit unchanged). It uses the threads and the root
+/// timeout of ic_set_filename_threads(). Returns the previous maximal depth.
+long ic_set_filename_glob_limits(long max_depth, long max_entries);
+
+/// Disable or enable fuzzy completion (disabled by default).
+/// When enabled, the built-in completers (and ic_add_completions()) accept any
+/// candidate that contains the characters of the current word in order
+/// (ignoring ascii case), so `gco` matches `git-checkout`. The completions are
+/// then ranked by their fuzzy score, and hints are only shown for prefix matches.
+/// @see ic_completion_matches() and ic_fuzzy_score() to use it in a completer.
+/// @returns the previous setting.
+bool ic_enable_fuzzy(bool enable);
+
 /// Disable or enable spell correction in completion (disabled by default).
 /// When enabled and no completion matches, tab will try to correct the
 /// current token to the closest available completion.
 /// @returns the previous setting.
 bool ic_enable_spell_correct(bool enable);
 
+/// Set the dictionary used for spell correction, for example all known
+/// commands and builtins of a shell. The words are copied and indexed once so
+/// the closest word is found quickly. The closest dictionary word is used
+/// unless one of the available completions (like a file name) is closer to
+/// the current token; if the token is in the dictionary (ignoring case) the
+/// completer is not run at all.
+/// @param words A `NULL` terminated array of words, or `NULL` to remove the dictionary.
+/// @returns `false` if out of memory (and the dictionary is removed).
+bool ic_set_spell_dictionary(const char** words);
+
 /// Set millisecond delay before a hint is displayed. Can be zero. (500ms by
 /// default).
 long ic_set_hint_delay(long delay_ms);
@@ -608,10 +827,23 @@ void* ic_completion_arg(const ic_completion_env_t* cenv);
 /// Do we have already some completions?
 bool ic_has_completions(const ic_completion_env_t* cenv);
 
-/// Do we already have enough completions and should we return if possible? (for
+/// Do we already have enough completions, or are we out of the time budget
+/// (see ic_set_completion_budget()), and should we return if possible? (for
 /// improved latency)
 bool ic_stop_completing(const ic_completion_env_t* cenv);
 
+/// Does a `candidate` match the `prefix` that is completed? This is
+/// ic_istarts_with() normally, but a fuzzy match if ic_enable_fuzzy() is set.
+/// Completers can use this to support fuzzy completion.
+bool ic_completion_matches(const ic_completion_env_t* cenv, const char* candidate,
+                           const char* prefix);
+
+/// Fuzzy score of `candidate` for a `pattern`: returns -1 if the characters of
+/// the `pattern` do not occur in order (ignoring ascii case) in the `candidate`,
+/// and otherwise a score `>= 0` where higher is better. Matches at the start,
+/// at word boundaries, and consecutive matches score higher.
+long ic_fuzzy_score(const char* pattern, const char* candidate);
+
 /// Primitive completion, cannot be used with most transformers (like
 /// `ic_complete_word` and `ic_complete_qword`). When completed, `delete_before`
 /// _bytes_ are deleted before the cursor position, `delete_after` _bytes_ are
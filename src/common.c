@@ -12,6 +12,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
 
 // Unicode helpers provided by CJ's Shell utilities
 #include "utils/unicode_support.h"
@@ -332,6 +337,55 @@ ic_private void debug_msg(const char* fmt, ...) {
 }
 #endif
 
+//-------------------------------------------------------------
+// Monotonic clock
+//-------------------------------------------------------------
+
+ic_private long long ic_clock_ms(void) {
+#if defined(_WIN32)
+    return (long long)GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((long long)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+#endif
+}
+
+#if !defined(_WIN32) && !defined(IC_NO_THREADS)
+ic_private int ic_cond_init(pthread_cond_t* cond) {
+#if defined(__APPLE__)
+    return pthread_cond_init(cond, NULL);  // waits are relative (see `ic_cond_timedwait`)
+#else
+    pthread_condattr_t attr;
+    int err = pthread_condattr_init(&attr);
+    if (err != 0)
+        return err;
+    err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (err == 0)
+        err = pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+    return err;
+#endif
+}
+
+ic_private int ic_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* lock,
+                                 long long deadline) {
+    struct timespec ts;
+#if defined(__APPLE__)
+    long long wait = deadline - ic_clock_ms();
+    if (wait < 0)
+        wait = 0;
+    ts.tv_sec = (time_t)(wait / 1000);
+    ts.tv_nsec = (long)((wait % 1000) * 1000000);
+    return pthread_cond_timedwait_relative_np(cond, lock, &ts);
+#else
+    ts.tv_sec = (time_t)(deadline / 1000);
+    ts.tv_nsec = (long)((deadline % 1000) * 1000000);
+    return pthread_cond_timedwait(cond, lock, &ts);
+#endif
+}
+#endif
+
 //-------------------------------------------------------------
 // Allocation
 //-------------------------------------------------------------
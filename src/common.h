@@ -158,6 +158,23 @@ ic_private ic_color_t ic_rgbx(ssize_t r, ssize_t g, ssize_t b);
 ic_private void debug_msg(const char* fmt, ...);
 #endif
 
+//-------------------------------------------------------------
+// Monotonic clock
+// Deadlines and time budgets are in milliseconds on a clock
+// that is not affected by changes to the wall-clock time.
+//-------------------------------------------------------------
+
+ic_private long long ic_clock_ms(void);
+
+#if !defined(_WIN32) && !defined(IC_NO_THREADS)
+#include <pthread.h>
+// initialize a condition variable whose timed waits use `ic_clock_ms`
+ic_private int ic_cond_init(pthread_cond_t* cond);
+// wait on `cond` at most until `deadline` (in `ic_clock_ms` time)
+ic_private int ic_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* lock,
+                                 long long deadline);
+#endif
+
 //-------------------------------------------------------------
 // Abstract environment
 //-------------------------------------------------------------
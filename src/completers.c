@@ -30,6 +30,7 @@
 #include "common.h"
 #include "completions.h"
 #include "env.h"
+#include "fuzzy.h"
 #include "isocline.h"
 #include "stringbuf.h"
 
@@ -82,7 +83,7 @@ ic_public void ic_complete_word(ic_completion_env_t* cenv, const char* prefix,
     word_closure_t wenv;
     wenv.delete_before_adjust = (long)(len - pos);
     wenv.prev_complete = cenv->complete;
-    wenv.prev_env = cenv->env;
+    wenv.prev_env = cenv->closure;
     cenv->complete = &token_add_completion_ex;
     cenv->closure = &wenv;
 
@@ -270,7 +271,7 @@ ic_public void ic_complete_qword_ex(ic_completion_env_t* cenv, const char* prefi
     wenv.escape_char = escape_char;
     wenv.delete_before_adjust = (long)(len - pos);
     wenv.prev_complete = cenv->complete;
-    wenv.prev_env = cenv->env;
+    wenv.prev_env = cenv->closure;
     wenv.sbuf = sbuf_new(cenv->env->mem);
     if (wenv.sbuf == NULL) {
         mem_free(cenv->env->mem, word);
@@ -314,63 +315,103 @@ typedef enum file_type_e {
     FT_LAST
 } file_type_t;
 
+// LS_COLORS (GNU) or LSCOLORS (BSD) is parsed once into an attribute per file type
+// and a hash table of `*.ext` patterns; colorizing a file name is then a lookup and
+// the attribute is applied directly to its (plain) display in the completion menu.
+#define IC_LS_EXT_SLOTS (1024)  // a power of 2
+#define IC_LS_EXT_MAX (768)     // at most 3/4 of the slots are used
+#define IC_LS_SUFFIX_MAX (32)
+
+typedef struct ls_suffix_s {
+    const char* s;  // points into the environment string (NULL for an empty slot)
+    ssize_t len;
+    attr_t attr;
+} ls_suffix_t;
+
 static int cli_color;  // 1 enabled, 0 not initialized, -1 disabled
 static const char* lscolors = "exfxcxdxbxegedabagacad";  // default BSD setting
 static const char* ls_colors;
-static const char* ls_colors_names[] = {"no=", "di=", "ln=", "so=", "pi=", "bd=", "cd=",
-                                        "su=", "sg=", "tw=", "ow=", "st=", "ex=", NULL};
+static const char* ls_colors_names[] = {"no", "di", "ln", "so", "pi", "bd", "cd",
+                                        "su", "sg", "tw", "ow", "st", "ex", NULL};
+static attr_t ls_type_attrs[FT_LAST];
+static ls_suffix_t ls_exts[IC_LS_EXT_SLOTS];      // `*.ext` patterns (keyed on `.ext`)
+static ssize_t ls_ext_count;
+static ls_suffix_t ls_suffixes[IC_LS_SUFFIX_MAX];  // other `*suffix` patterns
+static ssize_t ls_suffix_count;
+
+// extensions match case-insensitively (as in GNU ls)
+static size_t ls_ext_hash(const char* s, ssize_t len) {
+    size_t h = 2166136261u;
+    for (ssize_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)ic_tolower(s[i])) * 16777619u;
+    }
+    return h;
+}
 
-static bool ls_colors_init(void) {
-    if (cli_color != 0)
-        return (cli_color >= 1);
-    // colors enabled?
-    const char* s = getenv("CLICOLOR");
-    if (s == NULL || (strcmp(s, "1") != 0 && strcmp(s, "") != 0)) {
-        cli_color = -1;
+static bool ls_ext_eq(const ls_suffix_t* e, const char* s, ssize_t len) {
+    if (e->len != len)
         return false;
-    }
-    cli_color = 1;
-    s = getenv("LS_COLORS");
-    if (s != NULL) {
-        ls_colors = s;
-    }
-    s = getenv("LSCOLORS");
-    if (s != NULL) {
-        lscolors = s;
+    for (ssize_t i = 0; i < len; i++) {
+        if (ic_tolower(e->s[i]) != ic_tolower(s[i]))
+            return false;
     }
     return true;
 }
 
-static bool ls_valid_esc(ssize_t c) {
-    return ((c == 0 || c == 1 || c == 4 || c == 7 || c == 22 || c == 24 || c == 27) ||
-            (c >= 30 && c <= 37) || (c >= 40 && c <= 47) || (c >= 90 && c <= 97) ||
-            (c >= 100 && c <= 107));
+static ls_suffix_t* ls_ext_slot(const char* s, ssize_t len) {
+    const size_t mask = IC_LS_EXT_SLOTS - 1;
+    for (size_t i = ls_ext_hash(s, len) & mask;; i = (i + 1) & mask) {
+        ls_suffix_t* e = &ls_exts[i];
+        if (e->s == NULL || ls_ext_eq(e, s, len))
+            return e;
+    }
 }
 
-static bool ls_colors_from_key(stringbuf_t* sb, const char* key) {
-    // find key
-    ssize_t keylen = ic_strlen(key);
-    if (keylen <= 0)
-        return false;
-    const char* p = strstr(ls_colors, key);
-    if (p == NULL)
-        return false;
-    p += keylen;
-    if (key[keylen - 1] != '=') {
-        if (*p != '=')
-            return false;
-        p++;
-    }
-    ssize_t len = 0;
-    while (p[len] != 0 && p[len] != ':') {
-        len++;
+static void ls_colors_parse_gnu(const char* s) {
+    while (*s != 0) {
+        const char* key = s;
+        while (*s != 0 && *s != '=' && *s != ':') {
+            s++;
+        }
+        const ssize_t keylen = (s - key);
+        if (*s != '=') {
+            if (*s == ':')
+                s++;
+            continue;
+        }
+        const char* val = ++s;
+        while (*s != 0 && *s != ':') {
+            s++;
+        }
+        const attr_t attr = attr_from_sgr(val, (s - val));
+        if (*s == ':')
+            s++;
+        if (keylen > 2 && key[0] == '*' && key[1] == '.') {
+            ls_suffix_t* e = ls_ext_slot(key + 1, keylen - 1);
+            if (e->s == NULL) {
+                if (ls_ext_count >= IC_LS_EXT_MAX)
+                    continue;
+                ls_ext_count++;
+            }
+            e->s = key + 1;  // a later pattern overrides an earlier one
+            e->len = keylen - 1;
+            e->attr = attr;
+        } else if (keylen > 1 && key[0] == '*') {
+            if (ls_suffix_count < IC_LS_SUFFIX_MAX) {
+                ls_suffix_t* e = &ls_suffixes[ls_suffix_count++];
+                e->s = key + 1;
+                e->len = keylen - 1;
+                e->attr = attr;
+            }
+        } else if (keylen == 2) {
+            for (ssize_t ft = 0; ls_colors_names[ft] != NULL; ft++) {
+                if (strncmp(ls_colors_names[ft], key, 2) == 0) {
+                    ls_type_attrs[ft] = attr;
+                    break;
+                }
+            }
+        }
     }
-    if (len <= 0)
-        return false;
-    sbuf_append(sb, "[ansi-sgr=\"");
-    sbuf_append_n(sb, p, len);
-    sbuf_append(sb, "\"]");
-    return true;
 }
 
 static int ls_colors_from_char(char c) {
@@ -384,60 +425,82 @@ static int ls_colors_from_char(char c) {
         return 256;  // default
 }
 
-static bool ls_colors_append(stringbuf_t* sb, file_type_t ft, const char* ext) {
-    if (!ls_colors_init())
-        return false;
-    if (ls_colors != NULL) {
-        // GNU style
-        if (ft == FT_DEFAULT && ext != NULL) {
-            // first try extension match
-            if (ls_colors_from_key(sb, ext))
-                return true;
-        }
-        if (ft >= FT_DEFAULT && ft < FT_LAST) {
-            // then a filetype match
-            const char* key = ls_colors_names[ft];
-            if (ls_colors_from_key(sb, key))
-                return true;
-        }
-    } else if (lscolors != NULL) {
-        // BSD style
+static void ls_colors_parse_bsd(const char* s) {
+    const ssize_t len = ic_strlen(s);
+    for (ssize_t ft = 0; ft < FT_LAST; ft++) {
         char fg = 'x';
         char bg = 'x';
-        if (ic_strlen(lscolors) > (2 * (ssize_t)ft) + 1) {
-            fg = lscolors[2 * ft];
-            bg = lscolors[2 * ft + 1];
+        if (len > (2 * ft) + 1) {
+            fg = s[2 * ft];
+            bg = s[2 * ft + 1];
         }
-        sbuf_appendf(sb, "[ansi-color=%d ansi-bgcolor=%d]", ls_colors_from_char(fg),
-                     ls_colors_from_char(bg));
-        return true;
+        attr_t attr = attr_none();
+        attr.x.color = color_from_ansi256(ls_colors_from_char(fg));
+        attr.x.bgcolor = color_from_ansi256(ls_colors_from_char(bg));
+        ls_type_attrs[ft] = attr;
     }
-    return false;
 }
 
-static void ls_colorize(bool no_lscolor, stringbuf_t* sb, file_type_t ft, const char* name,
-                        const char* ext, char dirsep) {
-    bool close = (no_lscolor ? false : ls_colors_append(sb, ft, ext));
-    sbuf_append(sb, "[!pre]");
-    sbuf_append(sb, name);
-    if (dirsep != 0)
-        sbuf_append_char(sb, dirsep);
-    sbuf_append(sb, "[/pre]");
-    if (close) {
-        sbuf_append(sb, "[/]");
+// initializes the tables once; must be called before any completion worker starts
+static bool ls_colors_init(void) {
+    if (cli_color != 0)
+        return (cli_color >= 1);
+    // colors enabled?
+    const char* s = getenv("CLICOLOR");
+    if (s == NULL || (strcmp(s, "1") != 0 && strcmp(s, "") != 0)) {
+        cli_color = -1;
+        return false;
+    }
+    s = getenv("LS_COLORS");
+    if (s != NULL) {
+        ls_colors = s;
+    }
+    s = getenv("LSCOLORS");
+    if (s != NULL) {
+        lscolors = s;
+    }
+    if (ls_colors != NULL) {
+        ls_colors_parse_gnu(ls_colors);
+    } else if (lscolors != NULL) {
+        ls_colors_parse_bsd(lscolors);
+    }
+    cli_color = 1;
+    return true;
+}
+
+// initialize the state shared by the completers before they may run concurrently
+ic_private void completers_prepare(void) {
+    ls_colors_init();
+}
+
+// the attribute of a file `name` of type `ft`
+static attr_t ls_colors_attr(bool no_lscolor, file_type_t ft, const char* name) {
+    if (no_lscolor || !ls_colors_init() || ft < FT_DEFAULT || ft >= FT_LAST)
+        return attr_none();
+    if (ft == FT_DEFAULT && (ls_ext_count > 0 || ls_suffix_count > 0)) {
+        // first try an extension match (the longest first)
+        const ssize_t len = ic_strlen(name);
+        for (ssize_t i = 0; ls_ext_count > 0 && i < len; i++) {
+            if (name[i] == '.') {
+                const ls_suffix_t* e = ls_ext_slot(name + i, len - i);
+                if (e->s != NULL)
+                    return e->attr;
+            }
+        }
+        for (ssize_t i = 0; i < ls_suffix_count; i++) {
+            const ls_suffix_t* e = &ls_suffixes[i];
+            if (e->len <= len && strncmp(name + len - e->len, e->s, (size_t)e->len) == 0)
+                return e->attr;
+        }
     }
+    // then a file type match
+    return ls_type_attrs[ft];
 }
 
 #if defined(_WIN32)
 #include <io.h>
 #include <sys/stat.h>
 
-static bool os_is_dir(const char* cpath) {
-    struct _stat64 st = {0};
-    _stat64(cpath, &st);
-    return ((st.st_mode & _S_IFDIR) != 0);
-}
-
 static file_type_t os_get_filetype(const char* cpath) {
     struct _stat64 st = {0};
     _stat64(cpath, &st);
@@ -478,6 +541,21 @@ static const char* os_direntry_name(dir_entry* entry) {
     return entry->name;
 }
 
+static void os_direntry_filetype(dir_cursor d, dir_entry* entry, stringbuf_t* dir, bool exact,
+                                 file_type_t* ft, bool* isdir) {
+    ic_unused(d);
+    *isdir = ((entry->attrib & _A_SUBDIR) != 0);
+    if (!exact) {
+        *ft = (*isdir ? FT_DIR : FT_DEFAULT);
+        return;
+    }
+    const ssize_t dlen = sbuf_len(dir);
+    sbuf_append_char(dir, ic_dirsep());
+    sbuf_append(dir, entry->name);
+    *ft = os_get_filetype(sbuf_string(dir));
+    sbuf_delete_from(dir, dlen);  // restore dir
+}
+
 static bool os_path_is_absolute(const char* path) {
     if (path != NULL && path[0] != 0 && path[1] == ':' &&
         (path[2] == '\\' || path[2] == '/' || path[2] == 0)) {
@@ -497,20 +575,18 @@ ic_private char ic_dirsep(void) {
 #include <sys/stat.h>
 #include <sys/types.h>
 
-static bool os_is_dir(const char* cpath) {
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    stat(cpath, &st);
-    return (S_ISDIR(st.st_mode));
-}
-
-static file_type_t os_get_filetype(const char* cpath) {
-    struct stat st;
-    memset(&st, 0, sizeof(st));
-    if (lstat(cpath, &st) != 0) {
-        return FT_DEFAULT;  // Error with lstat, return default file type
-    }
-    switch ((st.st_mode) & S_IFMT) {
+// File type information of a directory entry packed in a byte.
+// `FT_INFO_COARSE` is set when the file type is only known from `d_type`
+// (and may miss the mode bits that distinguish executables, sticky
+// directories etc.)
+#define FT_INFO_MASK (0x0F)
+#define FT_INFO_COARSE (0x10)
+#define FT_INFO_EXACT (0x20)
+#define FT_INFO_ISDIR (0x40)
+#define FT_INFO_ISDIR_KNOWN (0x80)
+
+static file_type_t os_filetype_from_mode(mode_t mode) {
+    switch (mode & S_IFMT) {
         case S_IFSOCK:
             return FT_SOCK;
         case S_IFLNK: {
@@ -523,27 +599,92 @@ static file_type_t os_get_filetype(const char* cpath) {
         case S_IFBLK:
             return FT_BLOCK;
         case S_IFDIR: {
-            if ((st.st_mode & S_ISUID) != 0)
+            if ((mode & S_ISUID) != 0)
                 return FT_SETUID;
-            if ((st.st_mode & S_ISGID) != 0)
+            if ((mode & S_ISGID) != 0)
                 return FT_SETGID;
-            if ((st.st_mode & S_IWGRP) != 0 && (st.st_mode & S_ISVTX) != 0)
+            if ((mode & S_IWGRP) != 0 && (mode & S_ISVTX) != 0)
                 return FT_DIR_OW_STICKY;
-            if ((st.st_mode & S_IWGRP))
+            if ((mode & S_IWGRP))
                 return FT_DIR_OW;
-            if ((st.st_mode & S_ISVTX))
+            if ((mode & S_ISVTX))
                 return FT_DIR_STICKY;
             return FT_DIR;
         }
         case S_IFREG:
         default: {
-            if ((st.st_mode & S_IXUSR) != 0)
+            if ((mode & S_IXUSR) != 0)
                 return FT_EXE;
             return FT_DEFAULT;
         }
     }
 }
 
+// initial file type information from the `d_type` field of a directory entry
+static uint8_t os_dtype_info_of(unsigned char d_type) {
+#if defined(DT_UNKNOWN)
+    switch (d_type) {
+        case DT_LNK:
+            return (FT_INFO_EXACT | FT_SYM);  // still need to follow the link for `isdir`
+        case DT_DIR:
+            return (FT_INFO_COARSE | FT_INFO_ISDIR_KNOWN | FT_INFO_ISDIR | FT_DIR);
+        case DT_REG:
+            return (FT_INFO_COARSE | FT_INFO_ISDIR_KNOWN | FT_DEFAULT);
+        case DT_SOCK:
+            return (FT_INFO_EXACT | FT_INFO_ISDIR_KNOWN | FT_SOCK);
+        case DT_FIFO:
+            return (FT_INFO_EXACT | FT_INFO_ISDIR_KNOWN | FT_PIPE);
+        case DT_CHR:
+            return (FT_INFO_EXACT | FT_INFO_ISDIR_KNOWN | FT_CHAR);
+        case DT_BLK:
+            return (FT_INFO_EXACT | FT_INFO_ISDIR_KNOWN | FT_BLOCK);
+        default:
+            return 0;
+    }
+#else
+    ic_unused(d_type);
+    return 0;
+#endif
+}
+
+static uint8_t os_dtype_info(const struct dirent* entry) {
+#if defined(DT_UNKNOWN)
+    return os_dtype_info_of(entry->d_type);
+#else
+    ic_unused(entry);
+    return 0;
+#endif
+}
+
+// Complete the file type information `info` of entry `name` in the directory `dfd`.
+// Only calls `fstatat` if the information is incomplete: for `DT_UNKNOWN`,
+// symbolic links, or if `exact` is requested (for colorizing) and only `d_type` is known.
+static uint8_t os_filetype_at(int dfd, const char* name, uint8_t info, bool exact) {
+    const bool ft_known = ((info & FT_INFO_EXACT) != 0 || (!exact && (info & FT_INFO_COARSE) != 0));
+    if (ft_known && (info & FT_INFO_ISDIR_KNOWN) != 0) {
+        return info;
+    }
+    struct stat st;
+    if ((info & FT_INFO_EXACT) == 0 || (info & FT_INFO_MASK) != FT_SYM) {
+        if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            return (FT_INFO_EXACT | FT_INFO_ISDIR_KNOWN | FT_DEFAULT);
+        }
+        info = (uint8_t)(FT_INFO_EXACT | (os_filetype_from_mode(st.st_mode) & FT_INFO_MASK));
+        if (!S_ISLNK(st.st_mode)) {
+            info |= FT_INFO_ISDIR_KNOWN;
+            if (S_ISDIR(st.st_mode))
+                info |= FT_INFO_ISDIR;
+            return info;
+        }
+    }
+    // symbolic link: follow it to see if it points to a directory
+    info |= FT_INFO_ISDIR_KNOWN;
+    if (fstatat(dfd, name, &st, 0) == 0 && S_ISDIR(st.st_mode)) {
+        info |= FT_INFO_ISDIR;
+    }
+    return info;
+}
+
 #define dir_cursor DIR*
 #define dir_entry struct dirent*
 
@@ -570,6 +711,14 @@ static const char* os_direntry_name(dir_entry* entry) {
     return (*entry)->d_name;
 }
 
+static void os_direntry_filetype(dir_cursor d, dir_entry* entry, stringbuf_t* dir, bool exact,
+                                 file_type_t* ft, bool* isdir) {
+    ic_unused(dir);
+    const uint8_t info = os_filetype_at(dirfd(d), (*entry)->d_name, os_dtype_info(*entry), exact);
+    *ft = (file_type_t)(info & FT_INFO_MASK);
+    *isdir = ((info & FT_INFO_ISDIR) != 0);
+}
+
 static bool os_path_is_absolute(const char* path) {
     return (path != NULL && path[0] == '/');
 }
@@ -579,6 +728,484 @@ ic_private char ic_dirsep(void) {
 }
 #endif
 
+//-------------------------------------------------------------
+// Directory listing cache
+// Listings (names and lazily resolved file types) are shared by
+// all roots and all readline calls in the process. A listing is
+// validated by the device, inode and modification time of the
+// directory, and on Linux it is also invalidated through inotify
+// (which catches changes that do not update the directory mtime,
+// like a `chmod` of an entry).
+//-------------------------------------------------------------
+#if !defined(_WIN32)
+
+#if defined(__linux__) && !defined(IC_NO_INOTIFY)
+#define IC_USE_INOTIFY
+#include <sys/inotify.h>
+#endif
+#include <time.h>
+
+#if !defined(IC_NO_THREADS)
+#define IC_USE_THREADS
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__)
+#define IC_ST_MTIME_NSEC(st) ((long)(st).st_mtimespec.tv_nsec)
+#elif defined(__linux__)
+#define IC_ST_MTIME_NSEC(st) ((long)(st).st_mtim.tv_nsec)
+#else
+#define IC_ST_MTIME_NSEC(st) (0L)
+#endif
+
+#define IC_DIRCACHE_MAX (32)  // maximal number of cached directory listings
+
+#if defined(__linux__) && !defined(IC_NO_GETDENTS)
+#define IC_USE_GETDENTS
+#include <sys/syscall.h>
+#define IC_DIRSTREAM_SIZE (512 * 1024)  // directories this large (`st_size`) are streamed
+#define IC_DIRSTREAM_BUF (256 * 1024)   // buffer size for `getdents64`
+#endif
+
+typedef struct dir_listing_s {
+    char* path;       // normalized directory path
+    dev_t dev;        // identity and modification time of the directory
+    ino_t ino;
+    time_t mtime;
+    long mtime_nsec;
+    time_t read_time;  // when the listing was read
+    bool stale;        // invalidated by inotify
+    bool evicted;      // no longer in the cache (freed when `refcount` drops to zero)
+    int refcount;      // number of completions currently using this listing
+    int wd;            // inotify watch descriptor (or -1)
+    uint64_t used;     // last use (for LRU eviction)
+    ssize_t count;     // number of entries
+    ssize_t* name_ofs;  // offset of each name in `names`
+    uint8_t* types;     // FT_INFO_ file type information per entry (resolved lazily)
+    char* names;        // all names (0 terminated) back-to-back
+    ssize_t names_len;
+} dir_listing_t;
+
+typedef struct dircache_s {
+    alloc_t* mem;
+    uint64_t tick;
+    int inotify_fd;
+    dir_listing_t* listings[IC_DIRCACHE_MAX];
+    alloc_t alloc;  // `mem` points here (the allocator passed in may be a temporary copy)
+} dircache_t;
+
+static dircache_t dircache = {NULL, 0, -1, {NULL}, {0}};
+
+// the cache can be used concurrently by the parallel filename completer
+#ifdef IC_USE_THREADS
+static pthread_mutex_t dircache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define dircache_lock() pthread_mutex_lock(&dircache_mutex)
+#define dircache_unlock() pthread_mutex_unlock(&dircache_mutex)
+#else
+#define dircache_lock() ((void)0)
+#define dircache_unlock() ((void)0)
+#endif
+
+static void dir_listing_free(alloc_t* mem, dir_listing_t* dl) {
+    if (dl == NULL)
+        return;
+#ifdef IC_USE_INOTIFY
+    if (dl->wd >= 0 && dircache.inotify_fd >= 0) {
+        // watch descriptors are per inode, so only remove it if no other listing uses it
+        bool shared = false;
+        for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+            dir_listing_t* other = dircache.listings[i];
+            if (other != NULL && other != dl && other->wd == dl->wd)
+                shared = true;
+        }
+        if (!shared)
+            inotify_rm_watch(dircache.inotify_fd, dl->wd);
+    }
+#endif
+    mem_free(mem, dl->path);
+    mem_free(mem, dl->name_ofs);
+    mem_free(mem, dl->types);
+    mem_free(mem, dl->names);
+    mem_free(mem, dl);
+}
+
+// remove a listing from the cache; it is freed once no completion uses it anymore
+static void dircache_evict(ssize_t i) {
+    dir_listing_t* dl = dircache.listings[i];
+    dircache.listings[i] = NULL;
+    if (dl == NULL)
+        return;
+    if (dl->refcount > 0) {
+        dl->evicted = true;
+    } else {
+        dir_listing_free(dircache.mem, dl);
+    }
+}
+
+ic_private void dircache_free(void) {
+    dircache_lock();
+    if (dircache.mem != NULL) {
+        for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+            dircache_evict(i);
+        }
+    }
+    if (dircache.inotify_fd >= 0) {
+        close(dircache.inotify_fd);
+        dircache.inotify_fd = -1;
+    }
+    dircache_unlock();
+}
+
+#ifdef IC_USE_INOTIFY
+// mark all listings watched by `wd` (or all if `wd < 0`) as stale
+static void dircache_mark_stale(int wd) {
+    for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+        dir_listing_t* dl = dircache.listings[i];
+        if (dl != NULL && (wd < 0 || dl->wd == wd)) {
+            dl->stale = true;
+        }
+    }
+}
+
+// process pending inotify events (without blocking)
+static void dircache_poll_inotify(void) {
+    if (dircache.inotify_fd < 0)
+        return;
+    union {
+        struct inotify_event ev;
+        char data[4096];
+    } ubuf;
+    const char* buf = ubuf.data;
+    while (true) {
+        ssize_t n = read(dircache.inotify_fd, ubuf.data, sizeof(ubuf.data));
+        if (n <= 0)
+            break;
+        for (ssize_t ofs = 0; ofs < n;) {
+            const struct inotify_event* ev = (const struct inotify_event*)(buf + ofs);
+            if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+                dircache_mark_stale(-1);
+            } else {
+                dircache_mark_stale(ev->wd);
+                if ((ev->mask & IN_IGNORED) != 0) {
+                    for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+                        dir_listing_t* dl = dircache.listings[i];
+                        if (dl != NULL && dl->wd == ev->wd)
+                            dl->wd = -1;
+                    }
+                }
+            }
+            ofs += ssizeof(struct inotify_event) + (ssize_t)ev->len;
+        }
+    }
+}
+
+static void dircache_watch(dir_listing_t* dl) {
+    dl->wd = -1;
+    if (dircache.inotify_fd < 0) {
+        dircache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (dircache.inotify_fd < 0)
+            return;
+    }
+    dl->wd = inotify_add_watch(dircache.inotify_fd, dl->path,
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+}
+#endif
+
+// read a directory listing from disk
+static dir_listing_t* dir_listing_read(alloc_t* mem, const char* path, const struct stat* st) {
+    dir_listing_t* dl = mem_zalloc_tp(mem, dir_listing_t);
+    if (dl == NULL)
+        return NULL;
+    dl->wd = -1;
+    dl->path = mem_strdup(mem, path);
+    DIR* d = opendir(path);
+    if (dl->path == NULL || d == NULL) {
+        if (d != NULL)
+            closedir(d);
+        dir_listing_free(mem, dl);
+        return NULL;
+    }
+    dl->dev = st->st_dev;
+    dl->ino = st->st_ino;
+    dl->mtime = st->st_mtime;
+    dl->mtime_nsec = IC_ST_MTIME_NSEC(*st);
+    dl->read_time = time(NULL);
+
+    ssize_t capacity = 0;
+    ssize_t names_capacity = 0;
+    bool ok = true;
+    struct dirent* entry;
+    while (ok && (entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        const ssize_t len = ic_strlen(name);
+        if (dl->count >= capacity) {
+            ssize_t newcap = (capacity <= 0 ? 64 : 2 * capacity);
+            ssize_t* new_ofs = mem_realloc_tp(mem, ssize_t, dl->name_ofs, newcap);
+            if (new_ofs != NULL)
+                dl->name_ofs = new_ofs;
+            uint8_t* new_types = mem_realloc_tp(mem, uint8_t, dl->types, newcap);
+            if (new_types != NULL)
+                dl->types = new_types;
+            if (new_ofs == NULL || new_types == NULL) {
+                ok = false;
+                break;
+            }
+            capacity = newcap;
+        }
+        if (dl->names_len + len + 1 > names_capacity) {
+            ssize_t newcap = (names_capacity <= 0 ? 1024 : 2 * names_capacity);
+            while (dl->names_len + len + 1 > newcap)
+                newcap *= 2;
+            char* new_names = mem_realloc_tp(mem, char, dl->names, newcap);
+            if (new_names == NULL) {
+                ok = false;
+                break;
+            }
+            dl->names = new_names;
+            names_capacity = newcap;
+        }
+        ic_memcpy(dl->names + dl->names_len, name, len + 1);
+        dl->name_ofs[dl->count] = dl->names_len;
+        dl->types[dl->count] = os_dtype_info(entry);
+        dl->names_len += len + 1;
+        dl->count++;
+    }
+    closedir(d);
+    if (!ok) {
+        dir_listing_free(mem, dl);
+        return NULL;
+    }
+    debug_msg("completion: read directory %s: %zd entries\n", path, dl->count);
+    return dl;
+}
+
+// is a cached listing still valid for the directory with status `st`?
+static bool dir_listing_is_valid(const dir_listing_t* dl, const struct stat* st) {
+    if (dl->stale || dl->dev != st->st_dev || dl->ino != st->st_ino ||
+        dl->mtime != st->st_mtime || dl->mtime_nsec != IC_ST_MTIME_NSEC(*st)) {
+        return false;
+    }
+    // if the directory was modified in the same second we read it, a later change
+    // may not be visible in the mtime (with a coarse timestamp granularity).
+    return (dl->mtime < dl->read_time);
+}
+
+// get a valid listing for `path` (read from disk if needed);
+// the listing must be released with `dircache_release`.
+static dir_listing_t* dircache_lookup(alloc_t* mem, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode))
+        return NULL;
+    dircache_lock();
+    if (dircache.mem == NULL) {
+        dircache.alloc = *mem;
+        dircache.mem = &dircache.alloc;
+    }
+#ifdef IC_USE_INOTIFY
+    dircache_poll_inotify();
+#endif
+    dircache.tick++;
+    for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+        dir_listing_t* dl = dircache.listings[i];
+        if (dl != NULL && strcmp(dl->path, path) == 0) {
+            if (dir_listing_is_valid(dl, &st)) {
+                dl->used = dircache.tick;
+                dl->refcount++;
+                dircache_unlock();
+                return dl;
+            }
+            dircache_evict(i);  // outdated
+            break;
+        }
+    }
+    mem = dircache.mem;
+    dircache_unlock();
+#ifdef IC_USE_GETDENTS
+    if (st.st_size >= IC_DIRSTREAM_SIZE) {
+        return NULL;  // too large to read completely: stream it instead
+    }
+#endif
+
+    // read the directory without holding the lock (it may be on a slow mount)
+    dir_listing_t* dl = dir_listing_read(mem, path, &st);
+    if (dl == NULL)
+        return NULL;
+
+    dircache_lock();
+    ssize_t slot = -1;
+    for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+        dir_listing_t* other = dircache.listings[i];
+        if (other != NULL && strcmp(other->path, path) == 0) {
+            dircache_evict(i);  // read concurrently by another completion
+        }
+        if (dircache.listings[i] == NULL && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        // evict the least recently used listing
+        slot = 0;
+        for (ssize_t i = 1; i < IC_DIRCACHE_MAX; i++) {
+            if (dircache.listings[i]->used < dircache.listings[slot]->used)
+                slot = i;
+        }
+        dircache_evict(slot);
+    }
+    dl->used = dircache.tick;
+    dl->refcount = 1;
+    dircache.listings[slot] = dl;
+#ifdef IC_USE_INOTIFY
+    dircache_watch(dl);
+#endif
+    dircache_unlock();
+    return dl;
+}
+
+static void dircache_release(dir_listing_t* dl) {
+    dircache_lock();
+    dl->refcount--;
+    if (dl->refcount <= 0 && dl->evicted) {
+        dir_listing_free(dircache.mem, dl);
+    }
+    dircache_unlock();
+}
+
+// resolve the file type of entry `i`; the directory is opened on demand in `*dfd`.
+static void dir_listing_entry_type(dir_listing_t* dl, ssize_t i, int* dfd, bool exact,
+                                   file_type_t* ft, bool* isdir) {
+    dircache_lock();
+    uint8_t info = dl->types[i];
+    dircache_unlock();
+    const bool ft_known = ((info & FT_INFO_EXACT) != 0 || (!exact && (info & FT_INFO_COARSE) != 0));
+    if (!ft_known || (info & FT_INFO_ISDIR_KNOWN) == 0) {
+        if (*dfd < 0) {
+            *dfd = open(dl->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        if (*dfd >= 0) {
+            info = os_filetype_at(*dfd, dl->names + dl->name_ofs[i], info, exact);
+            dircache_lock();
+            dl->types[i] = info;
+            dircache_unlock();
+        }
+    }
+    *ft = (file_type_t)(info & FT_INFO_MASK);
+    *isdir = ((info & FT_INFO_ISDIR) != 0);
+}
+
+static bool filename_add_entry(ic_completion_env_t* cenv, stringbuf_t* dir_prefix,
+                               stringbuf_t* display, const char* name, file_type_t ft, bool isdir,
+                               char dir_sep, const char* extensions);
+
+// complete from a cached listing; returns `false` if the directory cannot be listed
+static bool dircache_complete_indir(ic_completion_env_t* cenv, stringbuf_t* dir,
+                                    stringbuf_t* dir_prefix, stringbuf_t* display,
+                                    const char* base_prefix, char dir_sep, const char* extensions,
+                                    bool* cont) {
+    // normalize the directory path (without trailing separators) as the cache key
+    const ssize_t dlen = sbuf_len(dir);
+    ssize_t plen = dlen;
+    while (plen > 1 && sbuf_char_at(dir, plen - 1) == ic_dirsep()) {
+        plen--;
+    }
+    sbuf_delete_from(dir, plen);
+    dir_listing_t* dl = dircache_lookup(cenv->env->mem, (plen > 0 ? sbuf_string(dir) : "."));
+    if (dl == NULL) {
+        return false;
+    }
+    const bool exact = (!cenv->env->no_lscolors && ls_colors_init());
+    int dfd = -1;
+    *cont = true;
+    for (ssize_t i = 0; *cont && i < dl->count; i++) {
+        const char* name = dl->names + dl->name_ofs[i];
+        if (completions_match(cenv->env, name, base_prefix)) {
+            file_type_t ft;
+            bool isdir;
+            dir_listing_entry_type(dl, i, &dfd, exact, &ft, &isdir);
+            *cont = filename_add_entry(cenv, dir_prefix, display, name, ft, isdir, dir_sep,
+                                       extensions);
+        }
+    }
+    if (dfd >= 0) {
+        close(dfd);
+    }
+    dircache_release(dl);
+    return true;
+}
+
+#ifdef IC_USE_GETDENTS
+// the record layout returned by `getdents64`
+typedef struct os_dirent64_s {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+} os_dirent64_t;
+
+// Complete in a directory by streaming its entries with large `getdents64` reads.
+// Names are first filtered in bulk on their first character, and the scan stops as
+// soon as the completion limit is reached (the expanded menu completes again without
+// a limit). Returns `false` if the directory cannot be opened or is smaller than
+// `IC_DIRSTREAM_SIZE` (and is better read as usual).
+static bool filename_complete_stream(ic_completion_env_t* cenv, stringbuf_t* dir,
+                                     stringbuf_t* dir_prefix, stringbuf_t* display,
+                                     const char* base_prefix, char dir_sep,
+                                     const char* extensions, bool* cont) {
+    const int fd = open(sbuf_len(dir) > 0 ? sbuf_string(dir) : ".",
+                        O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < IC_DIRSTREAM_SIZE) {
+        close(fd);
+        return false;
+    }
+    char* buf = mem_malloc_tp_n(cenv->env->mem, char, IC_DIRSTREAM_BUF);
+    if (buf == NULL) {
+        close(fd);
+        return false;
+    }
+    const bool exact = (!cenv->env->no_lscolors && ls_colors_init());
+    // without fuzzy matching a name must start with the first character of the prefix
+    const bool filter = (!cenv->env->fuzzy && base_prefix[0] != 0);
+    const char c0 = ic_tolower(base_prefix[0]);
+    ssize_t visited = 0;
+    *cont = true;
+    while (*cont) {
+        const long n = syscall(SYS_getdents64, fd, buf, IC_DIRSTREAM_BUF);
+        if (n <= 0)
+            break;
+        for (long ofs = 0; *cont && ofs < n;) {
+            const os_dirent64_t* entry = (const os_dirent64_t*)(buf + ofs);
+            ofs += entry->d_reclen;
+            visited++;
+            const char* name = entry->d_name;
+            if (filter && ic_tolower(name[0]) != c0)
+                continue;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0 ||
+                !completions_match(cenv->env, name, base_prefix)) {
+                continue;
+            }
+            const uint8_t info = os_filetype_at(fd, name, os_dtype_info_of(entry->d_type), exact);
+            *cont = filename_add_entry(cenv, dir_prefix, display, name,
+                                       (file_type_t)(info & FT_INFO_MASK),
+                                       ((info & FT_INFO_ISDIR) != 0), dir_sep, extensions);
+        }
+    }
+    debug_msg("completion: streamed %zd entries of %s\n", visited, sbuf_string(dir));
+    mem_free(cenv->env->mem, buf);
+    close(fd);
+    return true;
+}
+#endif
+
+#else
+ic_private void dircache_free(void) {}
+#endif  // !_WIN32
+
 //-------------------------------------------------------------
 // File completion
 //-------------------------------------------------------------
@@ -622,9 +1249,69 @@ static bool match_extension(const char* name, const char* extensions) {
     return false;
 }
 
+#if defined(IC_USE_THREADS)
+static bool fname_job_add(ic_env_t* env, void* funenv, const char* replacement,
+                          const char* display, const char* help, long delete_before,
+                          long delete_after);
+static void fname_job_set_style(void* funenv, const char* display, attr_t attr);
+#endif
+
+// style the plain `display` of the next completion with `attr` (or stop if `display == NULL`)
+static void filename_set_style(ic_completion_env_t* cenv, const char* display, attr_t attr) {
+#if defined(IC_USE_THREADS)
+    if (cenv->complete == &fname_job_add) {
+        fname_job_set_style(cenv->closure, display, attr);
+        return;
+    }
+#endif
+    completions_set_style(cenv->env->completions, display, attr);
+}
+
+// add a single directory entry `name` as a completion
+static bool filename_add_entry(ic_completion_env_t* cenv, stringbuf_t* dir_prefix,
+                               stringbuf_t* display, const char* name, file_type_t ft, bool isdir,
+                               char dir_sep, const char* extensions) {
+    bool cont = true;
+    const ssize_t plen = sbuf_len(dir_prefix);
+    sbuf_append(dir_prefix, name);
+    if (isdir && dir_sep != 0) {
+        sbuf_append_char(dir_prefix, dir_sep);
+    }
+    if (isdir || match_extension(name, extensions)) {
+        // add completion
+        sbuf_clear(display);
+        sbuf_append(display, name);
+        if (isdir && dir_sep != 0)
+            sbuf_append_char(display, dir_sep);
+        filename_set_style(cenv, sbuf_string(display),
+                           ls_colors_attr(cenv->env->no_lscolors, ft, name));
+        cont = ic_add_completion_ex(cenv, sbuf_string(dir_prefix), sbuf_string(display), NULL);
+        filename_set_style(cenv, NULL, attr_none());
+    }
+    sbuf_delete_from(dir_prefix, plen);  // restore dir_prefix
+    return cont;
+}
+
 static bool filename_complete_indir(ic_completion_env_t* cenv, stringbuf_t* dir,
                                     stringbuf_t* dir_prefix, stringbuf_t* display,
                                     const char* base_prefix, char dir_sep, const char* extensions) {
+#if !defined(_WIN32)
+    if (!cenv->env->no_dircache) {
+        bool cont = true;
+        if (dircache_complete_indir(cenv, dir, dir_prefix, display, base_prefix, dir_sep,
+                                    extensions, &cont)) {
+            return cont;
+        }
+    }
+#endif
+#if defined(IC_USE_GETDENTS)
+    bool streamed_cont = true;
+    if (filename_complete_stream(cenv, dir, dir_prefix, display, base_prefix, dir_sep,
+                                 extensions, &streamed_cont)) {
+        return streamed_cont;
+    }
+#endif
+    const bool exact = (!cenv->env->no_lscolors && ls_colors_init());
     dir_cursor d = 0;
     dir_entry entry;
     bool cont = true;
@@ -632,33 +1319,13 @@ static bool filename_complete_indir(ic_completion_env_t* cenv, stringbuf_t* dir,
         do {
             const char* name = os_direntry_name(&entry);
             if (name != NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0 &&
-                ic_istarts_with(name, base_prefix)) {
+                completions_match(cenv->env, name, base_prefix)) {
                 // possible match, first check if it is a directory
                 file_type_t ft;
                 bool isdir;
-                const ssize_t plen = sbuf_len(dir_prefix);
-                sbuf_append(dir_prefix, name);
-                {  // check directory and potentially add a dirsep to the
-                   // dir_prefix
-                    const ssize_t dlen = sbuf_len(dir);
-                    sbuf_append_char(dir, ic_dirsep());
-                    sbuf_append(dir, name);
-                    ft = os_get_filetype(sbuf_string(dir));
-                    isdir = os_is_dir(sbuf_string(dir));
-                    if (isdir && dir_sep != 0) {
-                        sbuf_append_char(dir_prefix, dir_sep);
-                    }
-                    sbuf_delete_from(dir, dlen);  // restore dir
-                }
-                if (isdir || match_extension(name, extensions)) {
-                    // add completion
-                    sbuf_clear(display);
-                    ls_colorize(cenv->env->no_lscolors, display, ft, name, NULL,
-                                (isdir ? dir_sep : 0));
-                    cont = ic_add_completion_ex(cenv, sbuf_string(dir_prefix), sbuf_string(display),
-                                                NULL);
-                }
-                sbuf_delete_from(dir_prefix, plen);  // restore dir_prefix
+                os_direntry_filetype(d, &entry, dir, exact, &ft, &isdir);
+                cont = filename_add_entry(cenv, dir_prefix, display, name, ft, isdir, dir_sep,
+                                          extensions);
             }
         } while (cont && os_findnext(d, &entry));
         os_findclose(d);
@@ -672,14 +1339,876 @@ typedef struct filename_closure_s {
     char dir_sep;
 } filename_closure_t;
 
-static void filename_completer(ic_completion_env_t* cenv, const char* prefix) {
-    if (prefix == NULL)
-        return;
-    filename_closure_t* fclosure = (filename_closure_t*)cenv->arg;
-    stringbuf_t* root_dir = sbuf_new(cenv->env->mem);
-    stringbuf_t* dir_prefix = sbuf_new(cenv->env->mem);
-    stringbuf_t* display = sbuf_new(cenv->env->mem);
-    if (root_dir != NULL && dir_prefix != NULL && display != NULL) {
+//-------------------------------------------------------------
+// Parallel completion over multiple roots
+// Each root is scanned by a small pool of worker threads into a
+// private result buffer. The results are merged in root order
+// (so the completions are the same as with a sequential scan),
+// and a root that does not finish within the timeout (like a hung
+// mount) is skipped; its worker is abandoned and frees the shared
+// state when it eventually returns.
+//-------------------------------------------------------------
+#if defined(IC_USE_THREADS)
+
+typedef struct fname_job_s {
+    struct fname_pool_s* pool;
+    char* dir;                 // directory to complete in
+    char* results;             // "replacement\0display\0" pairs, each followed by an `attr_t`
+    const char* style_display;  // see `filename_set_style`
+    attr_t style_attr;
+    ssize_t results_len;
+    ssize_t results_capacity;
+    ssize_t count;             // number of result pairs
+    long long start;           // start time in ms (0 if not started yet)
+    bool done;
+} fname_job_t;
+
+typedef struct fname_pool_s {
+    alloc_t mem;       // copy of the allocator and environment settings
+    ic_env_t env;      // (abandoned workers may outlive the environment)
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int refcount;      // the completer and each running worker
+    bool abandoned;    // the completer stopped waiting
+    ssize_t max;       // maximal number of results per root
+    ssize_t next;      // next job to start
+    ssize_t count;
+    fname_job_t* jobs;
+    char* dir_prefix;
+    char* base;
+    char* extensions;
+    char dir_sep;
+} fname_pool_t;
+
+static void fname_pool_free(fname_pool_t* pool) {
+    alloc_t mem = pool->mem;
+    for (ssize_t i = 0; i < pool->count; i++) {
+        mem_free(&mem, pool->jobs[i].dir);
+        mem_free(&mem, pool->jobs[i].results);
+    }
+    mem_free(&mem, pool->jobs);
+    mem_free(&mem, pool->dir_prefix);
+    mem_free(&mem, pool->base);
+    mem_free(&mem, pool->extensions);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+    mem_free(&mem, pool);
+}
+
+static void fname_pool_release(fname_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    const bool last = (--pool->refcount == 0);
+    pthread_mutex_unlock(&pool->lock);
+    if (last) {
+        fname_pool_free(pool);
+    }
+}
+
+// collects the completions of a single root
+static bool fname_job_add(ic_env_t* env, void* funenv, const char* replacement,
+                          const char* display, const char* help, long delete_before,
+                          long delete_after) {
+    ic_unused(help);
+    ic_unused(delete_before);
+    ic_unused(delete_after);
+    ic_unused(env);
+    fname_job_t* job = (fname_job_t*)funenv;
+    fname_pool_t* pool = job->pool;
+    if (display == NULL)
+        display = replacement;
+    const attr_t attr = (display == job->style_display ? job->style_attr : attr_none());
+    const ssize_t rlen = ic_strlen(replacement) + 1;
+    const ssize_t dlen = ic_strlen(display) + 1;
+    const ssize_t alen = ssizeof(attr_t);
+    if (job->results_len + rlen + dlen + alen > job->results_capacity) {
+        ssize_t newcap = (job->results_capacity <= 0 ? 1024 : 2 * job->results_capacity);
+        while (job->results_len + rlen + dlen + alen > newcap)
+            newcap *= 2;
+        char* newres = mem_realloc_tp(&pool->mem, char, job->results, newcap);
+        if (newres == NULL)
+            return false;
+        job->results = newres;
+        job->results_capacity = newcap;
+    }
+    ic_memcpy(job->results + job->results_len, replacement, rlen);
+    ic_memcpy(job->results + job->results_len + rlen, display, dlen);
+    ic_memcpy(job->results + job->results_len + rlen + dlen, &attr, alen);
+    job->results_len += rlen + dlen + alen;
+    job->count++;
+    return (job->count < pool->max);
+}
+
+static void fname_job_set_style(void* funenv, const char* display, attr_t attr) {
+    fname_job_t* job = (fname_job_t*)funenv;
+    job->style_display = display;
+    job->style_attr = attr;
+}
+
+static bool filename_complete_indir(ic_completion_env_t* cenv, stringbuf_t* dir,
+                                    stringbuf_t* dir_prefix, stringbuf_t* display,
+                                    const char* base_prefix, char dir_sep, const char* extensions);
+
+static void fname_job_run(fname_pool_t* pool, fname_job_t* job) {
+    ic_completion_env_t cenv;
+    memset(&cenv, 0, sizeof(cenv));
+    cenv.env = &pool->env;
+    cenv.closure = job;
+    cenv.complete = &fname_job_add;
+    stringbuf_t* dir = sbuf_new(&pool->mem);
+    stringbuf_t* dir_prefix = sbuf_new(&pool->mem);
+    stringbuf_t* display = sbuf_new(&pool->mem);
+    if (dir != NULL && dir_prefix != NULL && display != NULL) {
+        sbuf_append(dir, job->dir);
+        sbuf_append(dir_prefix, pool->dir_prefix);
+        filename_complete_indir(&cenv, dir, dir_prefix, display, pool->base, pool->dir_sep,
+                                pool->extensions);
+    }
+    sbuf_free(display);
+    sbuf_free(dir_prefix);
+    sbuf_free(dir);
+}
+
+static void* fname_worker(void* arg) {
+    fname_pool_t* pool = (fname_pool_t*)arg;
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->abandoned && pool->next < pool->count) {
+        fname_job_t* job = &pool->jobs[pool->next++];
+        job->start = ic_clock_ms();
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->lock);
+        fname_job_run(pool, job);
+        pthread_mutex_lock(&pool->lock);
+        job->done = true;
+        pthread_cond_broadcast(&pool->cond);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    fname_pool_release(pool);
+    return NULL;
+}
+
+// wait until all roots are done or timed out; called with the pool lock held
+static void fname_pool_wait(fname_pool_t* pool, ssize_t threads, long timeout) {
+    while (true) {
+        const long long now = ic_clock_ms();
+        long long wake = now + timeout;
+        bool running = false;
+        ssize_t stuck = 0;
+        for (ssize_t i = 0; i < pool->next; i++) {
+            const fname_job_t* job = &pool->jobs[i];
+            if (job->done)
+                continue;
+            if (now - job->start >= timeout) {
+                stuck++;  // timed out
+            } else {
+                running = true;
+                if (job->start + timeout < wake)
+                    wake = job->start + timeout;
+            }
+        }
+        if (!running && (pool->next >= pool->count || stuck >= threads)) {
+            break;  // all done, or all workers are stuck in a timed out root
+        }
+        ic_cond_timedwait(&pool->cond, &pool->lock, wake);
+    }
+}
+
+// complete in all `roots` concurrently; returns `false` if the pool could not be created.
+static bool filename_complete_parallel(ic_completion_env_t* cenv, const char* roots,
+                                       const char* prefix, const char* base, char dir_sep,
+                                       const char* extensions) {
+    ic_env_t* env = cenv->env;
+    fname_pool_t* pool = mem_zalloc_tp(env->mem, fname_pool_t);
+    if (pool == NULL)
+        return false;
+    pool->env = *env;
+    pool->mem = *env->mem;
+    pool->env.mem = &pool->mem;
+    pool->max = completions_remaining(env->completions);
+    pool->dir_sep = dir_sep;
+    pool->base = mem_strdup(env->mem, (base != NULL ? base : prefix));
+    pool->dir_prefix = mem_strndup(env->mem, prefix, (base != NULL ? base - prefix : 0));
+    pool->extensions = mem_strdup(env->mem, extensions);
+    pool->count = 1;
+    for (const char* r = strchr(roots, ';'); r != NULL; r = strchr(r + 1, ';')) {
+        pool->count++;
+    }
+    pool->jobs = mem_zalloc_tp_n(env->mem, fname_job_t, pool->count);
+    stringbuf_t* root_dir = sbuf_new(env->mem);
+    bool ok = (pool->base != NULL && pool->dir_prefix != NULL && pool->extensions != NULL &&
+               pool->jobs != NULL && root_dir != NULL && pool->max > 0);
+    // create the directory of each root
+    const char* root = roots;
+    for (ssize_t i = 0; ok && i < pool->count; i++) {
+        sbuf_clear(root_dir);
+        const char* next = strchr(root, ';');
+        if (next == NULL) {
+            sbuf_append(root_dir, root);
+        } else {
+            sbuf_append_n(root_dir, root, next - root);
+            root = next + 1;
+        }
+        sbuf_append_char(root_dir, ic_dirsep());
+        if (base != NULL) {
+            sbuf_append_n(root_dir, prefix, (base - prefix) - 1);
+        }
+        pool->jobs[i].pool = pool;
+        pool->jobs[i].dir = mem_strdup(env->mem, sbuf_string(root_dir));
+        ok = (pool->jobs[i].dir != NULL);
+    }
+    sbuf_free(root_dir);
+    if (!ok || pthread_mutex_init(&pool->lock, NULL) != 0) {
+        for (ssize_t i = 0; pool->jobs != NULL && i < pool->count; i++) {
+            mem_free(env->mem, pool->jobs[i].dir);
+        }
+        mem_free(env->mem, pool->jobs);
+        mem_free(env->mem, pool->dir_prefix);
+        mem_free(env->mem, pool->base);
+        mem_free(env->mem, pool->extensions);
+        mem_free(env->mem, pool);
+        return false;
+    }
+    ic_cond_init(&pool->cond);
+    ls_colors_init();  // initialize before the workers use it
+
+    // start the workers
+    ssize_t threads = (env->fname_threads < pool->count ? env->fname_threads : pool->count);
+    pool->refcount = 1;
+    ssize_t started = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (ssize_t i = 0; i < threads; i++) {
+        pthread_t thread;
+        pool->refcount++;
+        if (pthread_create(&thread, NULL, &fname_worker, pool) != 0) {
+            pool->refcount--;
+            break;
+        }
+        pthread_detach(thread);
+        started++;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (started == 0) {
+        // no threads available: scan sequentially
+        pool->refcount++;
+        fname_worker(pool);
+        started = 1;
+    }
+
+    // wait for the results and add them in root order
+    pthread_mutex_lock(&pool->lock);
+    fname_pool_wait(pool, started, env->fname_timeout);
+    pool->abandoned = true;
+    pthread_mutex_unlock(&pool->lock);
+    bool cont = true;
+    for (ssize_t i = 0; cont && i < pool->count; i++) {
+        const fname_job_t* job = &pool->jobs[i];
+        if (!job->done) {
+            debug_msg("completion: root timed out: %s\n", job->dir);
+            continue;
+        }
+        const char* res = job->results;
+        for (ssize_t j = 0; cont && j < job->count; j++) {
+            const char* display = res + ic_strlen(res) + 1;
+            const char* next = display + ic_strlen(display) + 1;
+            attr_t attr;
+            ic_memcpy(&attr, next, ssizeof(attr_t));
+            completions_set_style(env->completions, display, attr);
+            cont = ic_add_completion_ex(cenv, res, display, NULL);
+            res = next + ssizeof(attr_t);
+        }
+    }
+    completions_set_style(env->completions, NULL, attr_none());
+    fname_pool_release(pool);
+    return true;
+}
+
+#endif  // IC_USE_THREADS
+
+//-------------------------------------------------------------
+// Recursive filename completion
+// A word with a `**` path component, like `src/**/ma`, completes
+// `ma` in `src` and in every directory below it (and `src/**/io/ma`
+// only in directories that end in `io/`). The tree is walked breadth
+// first by a pool of `fname_threads` threads and is bounded in depth,
+// in the number of visited entries, and in time (`fname_timeout`);
+// the walk stops as soon as enough completions are found. Hidden
+// entries (unless the completed name starts with a `.`), `.git`, and
+// entries matched by a `.gitignore` or `.ignore` file are skipped.
+// Ignore files support the common subset of the gitignore syntax:
+// `*`, `?`, and `[...]` globs, `!` negation, a trailing `/` for
+// directories, and a leading or inner `/` to anchor a pattern.
+//-------------------------------------------------------------
+#if !defined(_WIN32)
+#include <fnmatch.h>
+
+#define IC_GLOB_IGNORE_MAX (64 * 1024)  // maximal size of an ignore file
+
+#define GLOB_NEGATE (1)
+#define GLOB_DIRONLY (2)
+#define GLOB_ANCHORED (4)
+
+typedef struct glob_pattern_s {
+    const char* pattern;  // points into the `buf` of its ignore file
+    uint8_t flags;        // GLOB_ flags
+} glob_pattern_t;
+
+// the patterns of an ignore file; shared by all directories below it
+typedef struct glob_ignore_s {
+    struct glob_ignore_s* parent;  // ignore file of an ancestor directory (or NULL)
+    struct glob_ignore_s* next;    // all ignore files of a walk (for freeing)
+    ssize_t dir_len;               // length of the relative path of its directory
+    ssize_t count;
+    glob_pattern_t* patterns;
+    char* buf;
+} glob_ignore_t;
+
+typedef struct glob_dir_s {
+    char* rel;  // path relative to the walk root ("" or ending in `/`)
+    ssize_t depth;
+    glob_ignore_t* ignore;
+} glob_dir_t;
+
+typedef struct glob_walk_s {
+    alloc_t mem;  // copy of the allocator and environment settings
+    ic_env_t env;  // (abandoned workers may outlive the environment)
+#ifdef IC_USE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+    int refcount;     // the completer and each running worker
+    int running;      // number of running workers
+    bool stop;        // stop walking (limit reached or abandoned)
+    char* root;       // directory to walk (ending in a separator)
+    char* head;       // the word before `**`
+    char* rest_dir;   // directory part of the word after `**/` ("" or ending in `/`)
+    char* base;       // name to complete
+    char* extensions;
+    char dir_sep;
+    bool hidden;      // include hidden entries?
+    bool exact;       // resolve exact file types (for colorizing)?
+    ssize_t max_depth;
+    ssize_t max_entries;
+    ssize_t max;      // maximal number of results
+    long long deadline;
+    ssize_t entries;  // number of visited entries
+    glob_dir_t* queue;
+    ssize_t queue_count;
+    ssize_t queue_len;
+    ssize_t next;     // next directory to walk
+    ssize_t busy;     // number of directories being walked
+    glob_ignore_t* ignores;
+    char* results;    // "replacement\0display\0" pairs, each followed by an `attr_t`
+    ssize_t results_len;
+    ssize_t results_capacity;
+    ssize_t count;    // number of results
+} glob_walk_t;
+
+static void glob_lock(glob_walk_t* w) {
+#ifdef IC_USE_THREADS
+    pthread_mutex_lock(&w->lock);
+#else
+    ic_unused(w);
+#endif
+}
+
+static void glob_unlock(glob_walk_t* w) {
+#ifdef IC_USE_THREADS
+    pthread_mutex_unlock(&w->lock);
+#else
+    ic_unused(w);
+#endif
+}
+
+static void glob_signal(glob_walk_t* w) {
+#ifdef IC_USE_THREADS
+    pthread_cond_broadcast(&w->cond);
+#else
+    ic_unused(w);
+#endif
+}
+
+// find the first `**` path component in `word`
+static const char* glob_find(const char* word) {
+    for (const char* p = strstr(word, "**"); p != NULL; p = strstr(p + 1, "**")) {
+        if ((p == word || p[-1] == '/') && (p[2] == '/' || p[2] == 0))
+            return p;
+    }
+    return NULL;
+}
+
+// parse an ignore file in `buf` (which is modified in place)
+static glob_ignore_t* glob_ignore_parse(glob_walk_t* w, char* buf, ssize_t len) {
+    ssize_t lines = 1;
+    for (ssize_t i = 0; i < len; i++) {
+        if (buf[i] == '\n')
+            lines++;
+    }
+    glob_ignore_t* ig = mem_zalloc_tp(&w->mem, glob_ignore_t);
+    if (ig == NULL)
+        return NULL;
+    ig->patterns = mem_zalloc_tp_n(&w->mem, glob_pattern_t, lines);
+    if (ig->patterns == NULL) {
+        mem_free(&w->mem, ig);
+        return NULL;
+    }
+    ig->buf = buf;
+    for (char* line = buf; line != NULL && line < buf + len;) {
+        char* eol = strchr(line, '\n');
+        char* next = (eol != NULL ? eol + 1 : NULL);
+        ssize_t n = (eol != NULL ? eol - line : ic_strlen(line));
+        while (n > 0 && (line[n - 1] == '\r' || line[n - 1] == ' ')) {
+            n--;
+        }
+        line[n] = 0;
+        uint8_t flags = 0;
+        if (line[0] == '!') {
+            flags |= GLOB_NEGATE;
+            line++;
+            n--;
+        }
+        if (n > 0 && line[n - 1] == '/') {
+            flags |= GLOB_DIRONLY;
+            line[--n] = 0;
+        }
+        if (n > 0 && strchr(line, '/') != NULL) {
+            flags |= GLOB_ANCHORED;
+            if (line[0] == '/') {
+                line++;
+                n--;
+            }
+        }
+        if (n > 0 && line[0] != '#') {
+            ig->patterns[ig->count].pattern = line;
+            ig->patterns[ig->count].flags = flags;
+            ig->count++;
+        }
+        line = next;
+    }
+    return ig;
+}
+
+// read the ignore files in the directory `dfd` (at `rel`); returns the ignore
+// patterns that apply to its entries
+static glob_ignore_t* glob_ignore_read(glob_walk_t* w, int dfd, const glob_dir_t* gd) {
+    static const char* names[] = {".gitignore", ".ignore", NULL};
+    glob_ignore_t* ignore = gd->ignore;
+    for (ssize_t i = 0; names[i] != NULL; i++) {
+        int fd = openat(dfd, names[i], O_RDONLY);
+        if (fd < 0)
+            continue;
+        char* buf = mem_malloc_tp_n(&w->mem, char, IC_GLOB_IGNORE_MAX + 1);
+        ssize_t len = 0;
+        while (buf != NULL && len < IC_GLOB_IGNORE_MAX) {
+            ssize_t n = read(fd, buf + len, to_size_t(IC_GLOB_IGNORE_MAX - len));
+            if (n <= 0)
+                break;
+            len += n;
+        }
+        close(fd);
+        if (buf == NULL)
+            continue;
+        buf[len] = 0;
+        glob_ignore_t* ig = glob_ignore_parse(w, buf, len);
+        if (ig == NULL) {
+            mem_free(&w->mem, buf);
+            continue;
+        }
+        ig->parent = ignore;
+        ig->dir_len = ic_strlen(gd->rel);
+        glob_lock(w);
+        ig->next = w->ignores;
+        w->ignores = ig;
+        glob_unlock(w);
+        ignore = ig;
+    }
+    return ignore;
+}
+
+// is the entry `name` in the directory `rel` ignored? the deepest ignore file
+// and the last matching pattern in it take precedence.
+static bool glob_is_ignored(const glob_ignore_t* ig, const char* rel, const char* name, bool isdir,
+                            stringbuf_t* path) {
+    for (; ig != NULL; ig = ig->parent) {
+        for (ssize_t i = ig->count - 1; i >= 0; i--) {
+            const glob_pattern_t* p = &ig->patterns[i];
+            if ((p->flags & GLOB_DIRONLY) != 0 && !isdir)
+                continue;
+            bool match;
+            if ((p->flags & GLOB_ANCHORED) != 0) {
+                sbuf_replace(path, rel + ig->dir_len);
+                sbuf_append(path, name);
+                match = (fnmatch(p->pattern, sbuf_string(path), FNM_PATHNAME) == 0);
+            } else {
+                match = (fnmatch(p->pattern, name, 0) == 0);
+            }
+            if (match)
+                return ((p->flags & GLOB_NEGATE) == 0);
+        }
+    }
+    return false;
+}
+
+// does the directory `rel` end in the directory part of the completed word?
+static bool glob_rel_matches(const glob_walk_t* w, const char* rel) {
+    const ssize_t n = ic_strlen(w->rest_dir);
+    const ssize_t rlen = ic_strlen(rel);
+    if (n == 0)
+        return true;
+    if (rlen < n || strcmp(rel + rlen - n, w->rest_dir) != 0)
+        return false;
+    return (rlen == n || rel[rlen - n - 1] == '/');
+}
+
+// add a directory to walk; called with the lock held
+static void glob_push(glob_walk_t* w, const char* rel, const char* name, ssize_t depth,
+                      glob_ignore_t* ignore) {
+    if (w->queue_count >= w->queue_len) {
+        ssize_t newlen = (w->queue_len <= 0 ? 64 : 2 * w->queue_len);
+        glob_dir_t* newq = mem_realloc_tp(&w->mem, glob_dir_t, w->queue, newlen);
+        if (newq == NULL)
+            return;
+        w->queue = newq;
+        w->queue_len = newlen;
+    }
+    const ssize_t rlen = ic_strlen(rel);
+    const ssize_t nlen = ic_strlen(name);
+    char* path = mem_malloc_tp_n(&w->mem, char, rlen + nlen + 2);
+    if (path == NULL)
+        return;
+    ic_memcpy(path, rel, rlen);
+    ic_memcpy(path + rlen, name, nlen);
+    path[rlen + nlen] = (nlen > 0 ? '/' : 0);
+    path[rlen + nlen + 1] = 0;
+    glob_dir_t* gd = &w->queue[w->queue_count++];
+    gd->rel = path;
+    gd->depth = depth;
+    gd->ignore = ignore;
+    glob_signal(w);
+}
+
+// add a result; called with the lock held
+static void glob_add_result(glob_walk_t* w, const char* rel, const char* name, bool isdir,
+                            attr_t attr) {
+    const ssize_t hlen = ic_strlen(w->head);
+    const ssize_t rlen = ic_strlen(rel);
+    const ssize_t nlen = ic_strlen(name);
+    const ssize_t sep = (isdir && w->dir_sep != 0 ? 1 : 0);
+    const ssize_t dlen = rlen + nlen + sep + 1;
+    const ssize_t needed = hlen + dlen + dlen + ssizeof(attr_t);
+    if (w->results_len + needed > w->results_capacity) {
+        ssize_t newcap = (w->results_capacity <= 0 ? 1024 : 2 * w->results_capacity);
+        while (w->results_len + needed > newcap)
+            newcap *= 2;
+        char* newres = mem_realloc_tp(&w->mem, char, w->results, newcap);
+        if (newres == NULL) {
+            w->stop = true;
+            return;
+        }
+        w->results = newres;
+        w->results_capacity = newcap;
+    }
+    char* p = w->results + w->results_len;
+    for (ssize_t i = 0; i < 2; i++) {
+        if (i == 0) {
+            ic_memcpy(p, w->head, hlen);  // the replacement starts with the head
+            p += hlen;
+        }
+        ic_memcpy(p, rel, rlen);
+        ic_memcpy(p + rlen, name, nlen);
+        p += rlen + nlen;
+        if (sep > 0)
+            *p++ = w->dir_sep;
+        *p++ = 0;
+    }
+    ic_memcpy(p, &attr, ssizeof(attr_t));
+    w->results_len += needed;
+    w->count++;
+    if (w->count >= w->max) {
+        w->stop = true;
+    }
+}
+
+// account for `visited` entries; returns `false` if the walk should stop
+static bool glob_visited(glob_walk_t* w, ssize_t visited) {
+    glob_lock(w);
+    w->entries += visited;
+    if (w->entries >= w->max_entries || ic_clock_ms() >= w->deadline) {
+        w->stop = true;
+    }
+    const bool cont = !w->stop;
+    glob_unlock(w);
+    return cont;
+}
+
+static void glob_walk_dir(glob_walk_t* w, const glob_dir_t* gd, stringbuf_t* path,
+                          stringbuf_t* tmp) {
+    sbuf_replace(path, w->root);
+    sbuf_append(path, gd->rel);
+    DIR* d = opendir(sbuf_string(path));
+    if (d == NULL)
+        return;
+    const int dfd = dirfd(d);
+    glob_ignore_t* ignore = glob_ignore_read(w, dfd, gd);
+    const bool rel_match = glob_rel_matches(w, gd->rel);
+    const bool descend = (gd->depth < w->max_depth);
+    ssize_t visited = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (!w->hidden || name[1] == 0 || strcmp(name, "..") == 0 ||
+                               strcmp(name, ".git") == 0)) {
+            continue;
+        }
+        if (++visited >= 256) {
+            if (!glob_visited(w, visited))
+                break;
+            visited = 0;
+        }
+        const bool match = (rel_match && completions_match(&w->env, name, w->base));
+        if (!match && !descend)
+            continue;
+        const uint8_t info = os_filetype_at(dfd, name, os_dtype_info(entry), (match && w->exact));
+        const file_type_t ft = (file_type_t)(info & FT_INFO_MASK);
+        const bool isdir = ((info & FT_INFO_ISDIR) != 0);
+        if (ignore != NULL && glob_is_ignored(ignore, gd->rel, name, isdir, tmp))
+            continue;
+        if (match && (isdir || match_extension(name, w->extensions))) {
+            const attr_t attr = ls_colors_attr(w->env.no_lscolors, ft, name);
+            glob_lock(w);
+            if (!w->stop)
+                glob_add_result(w, gd->rel, name, isdir, attr);
+            glob_unlock(w);
+        }
+        if (isdir && descend && ft != FT_SYM) {  // do not follow links (which may cycle)
+            glob_lock(w);
+            glob_push(w, gd->rel, name, gd->depth + 1, ignore);
+            glob_unlock(w);
+        }
+    }
+    closedir(d);
+    glob_visited(w, visited);
+}
+
+static void glob_walk_free(glob_walk_t* w) {
+    alloc_t mem = w->mem;
+    for (ssize_t i = 0; i < w->queue_count; i++) {
+        mem_free(&mem, w->queue[i].rel);
+    }
+    while (w->ignores != NULL) {
+        glob_ignore_t* ig = w->ignores;
+        w->ignores = ig->next;
+        mem_free(&mem, ig->patterns);
+        mem_free(&mem, ig->buf);
+        mem_free(&mem, ig);
+    }
+    mem_free(&mem, w->queue);
+    mem_free(&mem, w->results);
+    mem_free(&mem, w->root);
+    mem_free(&mem, w->head);
+    mem_free(&mem, w->rest_dir);
+    mem_free(&mem, w->base);
+    mem_free(&mem, w->extensions);
+#ifdef IC_USE_THREADS
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+#endif
+    mem_free(&mem, w);
+}
+
+static void glob_walk_release(glob_walk_t* w) {
+    glob_lock(w);
+    const bool last = (--w->refcount == 0);
+    glob_unlock(w);
+    if (last) {
+        glob_walk_free(w);
+    }
+}
+
+// walk directories from the queue until it is empty (and no other worker can add more)
+static void* glob_worker(void* arg) {
+    glob_walk_t* w = (glob_walk_t*)arg;
+    stringbuf_t* path = sbuf_new(&w->mem);
+    stringbuf_t* tmp = sbuf_new(&w->mem);
+    glob_lock(w);
+    while (path != NULL && tmp != NULL && !w->stop) {
+#ifdef IC_USE_THREADS
+        while (!w->stop && w->next >= w->queue_count && w->busy > 0) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+#endif
+        if (w->stop || w->next >= w->queue_count)
+            break;
+        const glob_dir_t gd = w->queue[w->next++];
+        w->busy++;
+        glob_unlock(w);
+        glob_walk_dir(w, &gd, path, tmp);
+        glob_lock(w);
+        w->busy--;
+    }
+    w->running--;
+    glob_signal(w);
+    glob_unlock(w);
+    sbuf_free(tmp);
+    sbuf_free(path);
+    glob_walk_release(w);
+    return NULL;
+}
+
+// walk `root` and add the results; returns `false` if completion should stop
+static bool glob_walk_root(ic_completion_env_t* cenv, const char* root, const char* head,
+                           const char* rest, const char* extensions, char dir_sep) {
+    ic_env_t* env = cenv->env;
+    const ssize_t max = completions_remaining(env->completions);
+    if (max <= 0)
+        return false;
+    glob_walk_t* w = mem_zalloc_tp(env->mem, glob_walk_t);
+    if (w == NULL)
+        return false;
+    w->env = *env;
+    w->mem = *env->mem;
+    w->env.mem = &w->mem;
+    const char* base = strrchr(rest, '/');
+    base = (base != NULL ? base + 1 : rest);
+    w->root = mem_strdup(&w->mem, root);
+    w->head = mem_strdup(&w->mem, head);
+    w->rest_dir = mem_strndup(&w->mem, rest, base - rest);
+    w->base = mem_strdup(&w->mem, base);
+    w->extensions = mem_strdup(&w->mem, extensions);
+    w->dir_sep = dir_sep;
+    w->hidden = (base[0] == '.');
+    w->exact = (!env->no_lscolors && ls_colors_init());
+    w->max_depth = env->glob_depth;
+    w->max_entries = env->glob_entries;
+    w->max = max;
+    w->deadline = ic_clock_ms() + env->fname_timeout;
+    bool ok = (w->root != NULL && w->head != NULL && w->rest_dir != NULL && w->base != NULL &&
+               w->extensions != NULL);
+#ifdef IC_USE_THREADS
+    if (ok && pthread_mutex_init(&w->lock, NULL) != 0) {
+        ok = false;
+    } else if (ok) {
+        ic_cond_init(&w->cond);
+    }
+#endif
+    if (!ok) {
+        mem_free(&w->mem, w->root);
+        mem_free(&w->mem, w->head);
+        mem_free(&w->mem, w->rest_dir);
+        mem_free(&w->mem, w->base);
+        mem_free(&w->mem, w->extensions);
+        mem_free(env->mem, w);
+        return true;
+    }
+    w->refcount = 1;
+    glob_push(w, "", "", 0, NULL);
+
+    // start the workers, or walk on this thread
+    ssize_t started = 0;
+#ifdef IC_USE_THREADS
+    const long threads = (env->fname_threads > 1 ? env->fname_threads : 0);
+    glob_lock(w);
+    for (long i = 0; i < threads; i++) {
+        pthread_t thread;
+        w->refcount++;
+        w->running++;
+        if (pthread_create(&thread, NULL, &glob_worker, w) != 0) {
+            w->refcount--;
+            w->running--;
+            break;
+        }
+        pthread_detach(thread);
+        started++;
+    }
+    glob_unlock(w);
+#endif
+    if (started == 0) {
+        w->refcount++;
+        w->running++;
+        glob_worker(w);
+    }
+
+    // wait for the workers within the time limit
+    glob_lock(w);
+#ifdef IC_USE_THREADS
+    while (w->running > 0) {
+        const long long now = ic_clock_ms();
+        if (now >= w->deadline)
+            break;
+        ic_cond_timedwait(&w->cond, &w->lock, w->deadline);
+    }
+#endif
+    w->stop = true;  // workers that are still running add no more results
+    const bool timed_out = (w->running > 0);
+    glob_unlock(w);
+    if (timed_out) {
+        debug_msg("completion: recursive walk timed out: %s\n", root);
+    }
+
+    // add the results
+    bool cont = true;
+    const char* res = w->results;
+    for (ssize_t i = 0; cont && i < w->count; i++) {
+        const char* display = res + ic_strlen(res) + 1;
+        const char* next = display + ic_strlen(display) + 1;
+        attr_t attr;
+        ic_memcpy(&attr, next, ssizeof(attr_t));
+        filename_set_style(cenv, display, attr);
+        cont = ic_add_completion_ex(cenv, res, display, NULL);
+        res = next + ssizeof(attr_t);
+    }
+    filename_set_style(cenv, NULL, attr_none());
+    glob_walk_release(w);
+    return cont;
+}
+
+// complete a word with a `**` component; returns `false` if the word has none
+static bool filename_complete_glob(ic_completion_env_t* cenv, const char* prefix,
+                                   const filename_closure_t* fclosure) {
+    const char* glob = glob_find(prefix);
+    if (glob == NULL)
+        return false;
+    const char* rest = glob + 2;
+    if (*rest == '/')
+        rest++;
+    char* head = mem_strndup(cenv->env->mem, prefix, glob - prefix);
+    stringbuf_t* root = sbuf_new(cenv->env->mem);
+    if (head != NULL && root != NULL) {
+        if (os_path_is_absolute(prefix)) {
+            sbuf_append(root, head);
+            glob_walk_root(cenv, sbuf_string(root), head, rest, fclosure->extensions,
+                           fclosure->dir_sep);
+        } else {
+            // relative path, walk every root
+            bool cont = true;
+            for (const char* r = fclosure->roots; cont && r != NULL;) {
+                const char* next = strchr(r, ';');
+                sbuf_clear(root);
+                sbuf_append_n(root, r, (next != NULL ? next - r : ic_strlen(r)));
+                sbuf_append_char(root, ic_dirsep());
+                sbuf_append(root, head);
+                cont = glob_walk_root(cenv, sbuf_string(root), head, rest,
+                                      fclosure->extensions, fclosure->dir_sep);
+                r = (next != NULL ? next + 1 : NULL);
+            }
+        }
+    }
+    sbuf_free(root);
+    mem_free(cenv->env->mem, head);
+    return true;
+}
+#endif  // !_WIN32
+
+static void filename_completer(ic_completion_env_t* cenv, const char* prefix) {
+    if (prefix == NULL)
+        return;
+    filename_closure_t* fclosure = (filename_closure_t*)cenv->arg;
+#if !defined(_WIN32)
+    if (filename_complete_glob(cenv, prefix, fclosure))
+        return;
+#endif
+    stringbuf_t* root_dir = sbuf_new(cenv->env->mem);
+    stringbuf_t* dir_prefix = sbuf_new(cenv->env->mem);
+    stringbuf_t* display = sbuf_new(cenv->env->mem);
+    if (root_dir != NULL && dir_prefix != NULL && display != NULL) {
         // split prefix in dir_prefix / base.
         const char* base = strrchr(prefix, '/');
 #ifdef _WIN32
@@ -707,6 +2236,13 @@ static void filename_completer(ic_completion_env_t* cenv, const char* prefix) {
             // relative path, complete with respect to every root.
             const char* next;
             const char* root = fclosure->roots;
+#if defined(IC_USE_THREADS)
+            if (cenv->env->fname_threads > 1 && strchr(root, ';') != NULL &&
+                filename_complete_parallel(cenv, root, prefix, base, fclosure->dir_sep,
+                                           fclosure->extensions)) {
+                root = NULL;
+            }
+#endif
             while (root != NULL) {
                 // create full root in `root_dir`
                 sbuf_clear(root_dir);
@@ -753,3 +2289,981 @@ ic_public void ic_complete_filename(ic_completion_env_t* cenv, const char* prefi
     ic_complete_qword_ex(cenv, prefix, &filename_completer, &ic_char_is_filename_letter, '\\',
                          "'\"");
 }
+
+//-------------------------------------------------------------
+// Command completion
+// A process-wide sorted index of the executable names in the
+// `$PATH` directories. Lookups only binary search the current
+// snapshot of the index and never touch the file system. At
+// most once per second a lookup triggers a (background) check
+// of the `$PATH` directories where only directories whose
+// identity or mtime changed are read again.
+//-------------------------------------------------------------
+#if !defined(_WIN32)
+
+typedef struct cmd_dir_s {
+    char* path;
+    dev_t dev;  // identity and modification time when read
+    ino_t ino;
+    time_t mtime;
+    long mtime_nsec;
+    time_t read_time;
+    bool read;      // was the directory read successfully?
+    char* names;    // executable names (0 terminated) back-to-back
+    ssize_t names_len;
+    ssize_t count;
+} cmd_dir_t;
+
+typedef struct cmd_snapshot_s {
+    int refcount;
+    char* path_env;      // the `$PATH` this snapshot is built from
+    ssize_t count;
+    const char** names;  // sorted unique names (pointing into `buf`)
+    char* buf;
+} cmd_snapshot_t;
+
+typedef struct cmd_index_s {
+    alloc_t mem;               // copy of the allocator (a refresh may outlive the env)
+    bool has_mem;
+    cmd_snapshot_t* snapshot;  // current snapshot (guarded by the lock)
+    time_t checked;            // time of the last check of the directories
+    bool refreshing;           // is a refresh in progress?
+    // owned by the (single) active refresh
+    char* path_env;
+    cmd_dir_t* dirs;
+    ssize_t dir_count;
+} cmd_index_t;
+
+static cmd_index_t cmd_index;
+
+#ifdef IC_USE_THREADS
+static pthread_mutex_t cmd_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cmd_index_cond = PTHREAD_COND_INITIALIZER;
+#define cmd_index_lock() pthread_mutex_lock(&cmd_index_mutex)
+#define cmd_index_unlock() pthread_mutex_unlock(&cmd_index_mutex)
+#define cmd_index_wait() pthread_cond_wait(&cmd_index_cond, &cmd_index_mutex)
+#define cmd_index_signal() pthread_cond_broadcast(&cmd_index_cond)
+#else
+#define cmd_index_lock() ((void)0)
+#define cmd_index_unlock() ((void)0)
+#define cmd_index_wait() ((void)0)
+#define cmd_index_signal() ((void)0)
+#endif
+
+static void cmd_snapshot_release(cmd_snapshot_t* snap) {
+    if (snap == NULL)
+        return;
+    cmd_index_lock();
+    const bool last = (--snap->refcount <= 0);
+    cmd_index_unlock();
+    if (last) {
+        mem_free(&cmd_index.mem, snap->path_env);
+        mem_free(&cmd_index.mem, snap->names);
+        mem_free(&cmd_index.mem, snap->buf);
+        mem_free(&cmd_index.mem, snap);
+    }
+}
+
+static void cmd_dir_clear(cmd_dir_t* cd) {
+    mem_free(&cmd_index.mem, cd->path);
+    mem_free(&cmd_index.mem, cd->names);
+    memset(cd, 0, sizeof(*cd));
+}
+
+// (re)read the executables in a directory
+static void cmd_dir_read(cmd_dir_t* cd, const struct stat* st) {
+    mem_free(&cmd_index.mem, cd->names);
+    cd->names = NULL;
+    cd->names_len = 0;
+    cd->count = 0;
+    cd->read = false;
+    cd->dev = st->st_dev;
+    cd->ino = st->st_ino;
+    cd->mtime = st->st_mtime;
+    cd->mtime_nsec = IC_ST_MTIME_NSEC(*st);
+    cd->read_time = time(NULL);
+    DIR* d = opendir(cd->path);
+    if (d == NULL)
+        return;
+    ssize_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+            continue;
+        const uint8_t info = os_dtype_info(entry);
+        if ((info & FT_INFO_ISDIR_KNOWN) != 0 && (info & FT_INFO_ISDIR) != 0)
+            continue;
+        struct stat est;
+        if (fstatat(dirfd(d), name, &est, 0) != 0 || !S_ISREG(est.st_mode) ||
+            (est.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) == 0) {
+            continue;
+        }
+        const ssize_t len = ic_strlen(name);
+        if (cd->names_len + len + 1 > capacity) {
+            ssize_t newcap = (capacity <= 0 ? 1024 : 2 * capacity);
+            while (cd->names_len + len + 1 > newcap)
+                newcap *= 2;
+            char* newnames = mem_realloc_tp(&cmd_index.mem, char, cd->names, newcap);
+            if (newnames == NULL)
+                break;
+            cd->names = newnames;
+            capacity = newcap;
+        }
+        ic_memcpy(cd->names + cd->names_len, name, len + 1);
+        cd->names_len += len + 1;
+        cd->count++;
+    }
+    closedir(d);
+    cd->read = true;
+    debug_msg("completion: indexed %zd commands in %s\n", cd->count, cd->path);
+}
+
+// check a directory and re-read it if it changed; returns `true` if it changed.
+static bool cmd_dir_refresh(cmd_dir_t* cd) {
+    struct stat st;
+    if (stat(cd->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        const bool changed = (cd->read && cd->count > 0);
+        mem_free(&cmd_index.mem, cd->names);
+        cd->names = NULL;
+        cd->names_len = 0;
+        cd->count = 0;
+        cd->read = false;
+        return changed;
+    }
+    if (cd->read && cd->dev == st.st_dev && cd->ino == st.st_ino && cd->mtime == st.st_mtime &&
+        cd->mtime_nsec == IC_ST_MTIME_NSEC(st) && cd->mtime < cd->read_time) {
+        return false;  // unchanged
+    }
+    cmd_dir_read(cd, &st);
+    return true;
+}
+
+// update the directories to match `path_env`; returns `true` if anything changed.
+static bool cmd_index_set_dirs(const char* path_env) {
+    if (cmd_index.path_env != NULL && strcmp(cmd_index.path_env, path_env) == 0)
+        return false;
+    ssize_t count = 1;
+    for (const char* p = strchr(path_env, ':'); p != NULL; p = strchr(p + 1, ':')) {
+        count++;
+    }
+    cmd_dir_t* dirs = mem_zalloc_tp_n(&cmd_index.mem, cmd_dir_t, count);
+    char* pcopy = mem_strdup(&cmd_index.mem, path_env);
+    if (dirs == NULL || pcopy == NULL) {
+        mem_free(&cmd_index.mem, dirs);
+        mem_free(&cmd_index.mem, pcopy);
+        return false;
+    }
+    const char* p = path_env;
+    for (ssize_t i = 0; i < count; i++) {
+        const char* next = strchr(p, ':');
+        const ssize_t len = (next == NULL ? ic_strlen(p) : (ssize_t)(next - p));
+        // reuse a directory we read before
+        for (ssize_t j = 0; j < cmd_index.dir_count; j++) {
+            cmd_dir_t* old = &cmd_index.dirs[j];
+            if (old->path != NULL && ic_strlen(old->path) == len &&
+                strncmp(old->path, p, to_size_t(len)) == 0) {
+                dirs[i] = *old;
+                memset(old, 0, sizeof(*old));
+                break;
+            }
+        }
+        if (dirs[i].path == NULL) {
+            // an empty entry is the current directory
+            dirs[i].path = (len == 0 ? mem_strdup(&cmd_index.mem, ".")
+                                     : mem_strndup(&cmd_index.mem, p, len));
+        }
+        p = (next == NULL ? p + len : next + 1);
+    }
+    for (ssize_t j = 0; j < cmd_index.dir_count; j++) {
+        cmd_dir_clear(&cmd_index.dirs[j]);
+    }
+    mem_free(&cmd_index.mem, cmd_index.dirs);
+    mem_free(&cmd_index.mem, cmd_index.path_env);
+    cmd_index.dirs = dirs;
+    cmd_index.dir_count = count;
+    cmd_index.path_env = pcopy;
+    return true;
+}
+
+static int cmd_name_compare(const void* p1, const void* p2) {
+    return strcmp(*(const char* const*)p1, *(const char* const*)p2);
+}
+
+// build a new snapshot from the directories
+static cmd_snapshot_t* cmd_snapshot_build(void) {
+    alloc_t* mem = &cmd_index.mem;
+    ssize_t total = 0;
+    ssize_t total_len = 0;
+    for (ssize_t i = 0; i < cmd_index.dir_count; i++) {
+        total += cmd_index.dirs[i].count;
+        total_len += cmd_index.dirs[i].names_len;
+    }
+    cmd_snapshot_t* snap = mem_zalloc_tp(mem, cmd_snapshot_t);
+    const char** all = mem_zalloc_tp_n(mem, const char*, total + 1);
+    if (snap == NULL || all == NULL) {
+        mem_free(mem, snap);
+        mem_free(mem, all);
+        return NULL;
+    }
+    ssize_t n = 0;
+    for (ssize_t i = 0; i < cmd_index.dir_count; i++) {
+        const cmd_dir_t* cd = &cmd_index.dirs[i];
+        const char* name = cd->names;
+        for (ssize_t j = 0; j < cd->count; j++) {
+            all[n++] = name;
+            name += ic_strlen(name) + 1;
+        }
+    }
+    qsort(all, to_size_t(n), sizeof(all[0]), &cmd_name_compare);
+    // copy the unique names into the snapshot
+    snap->buf = mem_malloc_tp_n(mem, char, total_len + 1);
+    snap->names = all;
+    snap->path_env = mem_strdup(mem, cmd_index.path_env);
+    snap->refcount = 1;
+    if (snap->buf == NULL || snap->path_env == NULL) {
+        snap->refcount = 0;
+        cmd_snapshot_release(snap);
+        return NULL;
+    }
+    ssize_t ofs = 0;
+    for (ssize_t i = 0; i < n; i++) {
+        if (snap->count > 0 && strcmp(snap->names[snap->count - 1], all[i]) == 0)
+            continue;
+        const ssize_t len = ic_strlen(all[i]);
+        ic_memcpy(snap->buf + ofs, all[i], len + 1);
+        all[snap->count++] = snap->buf + ofs;
+        ofs += len + 1;
+    }
+    return snap;
+}
+
+// check all directories and swap in a new snapshot if anything changed.
+static void cmd_index_refresh(const char* path_env) {
+    bool changed = cmd_index_set_dirs(path_env);
+    for (ssize_t i = 0; i < cmd_index.dir_count; i++) {
+        if (cmd_dir_refresh(&cmd_index.dirs[i]))
+            changed = true;
+    }
+    cmd_snapshot_t* snap = NULL;
+    if (changed || cmd_index.snapshot == NULL) {
+        snap = cmd_snapshot_build();
+    }
+    cmd_index_lock();
+    cmd_snapshot_t* old = NULL;
+    if (snap != NULL) {
+        old = cmd_index.snapshot;
+        cmd_index.snapshot = snap;
+    }
+    cmd_index.refreshing = false;
+    cmd_index_signal();
+    cmd_index_unlock();
+    cmd_snapshot_release(old);
+}
+
+#ifdef IC_USE_THREADS
+static void* cmd_index_refresh_worker(void* arg) {
+    char* path_env = (char*)arg;
+    cmd_index_refresh(path_env);
+    mem_free(&cmd_index.mem, path_env);
+    return NULL;
+}
+#endif
+
+// get the current snapshot for `path_env` (must be released with `cmd_snapshot_release`)
+static cmd_snapshot_t* cmd_index_acquire(alloc_t* mem, const char* path_env) {
+    cmd_index_lock();
+    if (!cmd_index.has_mem) {
+        cmd_index.mem = *mem;
+        cmd_index.has_mem = true;
+    }
+    while (true) {
+        cmd_snapshot_t* snap = cmd_index.snapshot;
+        const bool current = (snap != NULL && strcmp(snap->path_env, path_env) == 0);
+        const time_t now = time(NULL);
+        if (current && (cmd_index.refreshing || now <= cmd_index.checked)) {
+            snap->refcount++;
+            cmd_index_unlock();
+            return snap;
+        }
+        if (cmd_index.refreshing) {
+            cmd_index_wait();  // wait for the refresh of another thread to finish
+            continue;
+        }
+        cmd_index.refreshing = true;
+        cmd_index.checked = now;
+#ifdef IC_USE_THREADS
+        if (current) {
+            // refresh in the background and use the current snapshot meanwhile
+            char* arg = mem_strdup(&cmd_index.mem, path_env);
+            pthread_t thread;
+            if (arg != NULL && pthread_create(&thread, NULL, &cmd_index_refresh_worker, arg) == 0) {
+                pthread_detach(thread);
+                snap->refcount++;
+                cmd_index_unlock();
+                return snap;
+            }
+            mem_free(&cmd_index.mem, arg);
+        }
+#endif
+        cmd_index_unlock();
+        cmd_index_refresh(path_env);
+        cmd_index_lock();
+        snap = cmd_index.snapshot;
+        if (snap == NULL || strcmp(snap->path_env, path_env) != 0) {
+            cmd_index_unlock();
+            return NULL;  // out of memory
+        }
+    }
+}
+
+ic_private void cmd_index_free(void) {
+    cmd_index_lock();
+    if (!cmd_index.has_mem || cmd_index.refreshing) {
+        cmd_index_unlock();
+        return;  // still in use by a background refresh
+    }
+    cmd_snapshot_t* snap = cmd_index.snapshot;
+    cmd_index.snapshot = NULL;
+    cmd_index.checked = 0;
+    for (ssize_t i = 0; i < cmd_index.dir_count; i++) {
+        cmd_dir_clear(&cmd_index.dirs[i]);
+    }
+    mem_free(&cmd_index.mem, cmd_index.dirs);
+    mem_free(&cmd_index.mem, cmd_index.path_env);
+    cmd_index.dirs = NULL;
+    cmd_index.dir_count = 0;
+    cmd_index.path_env = NULL;
+    cmd_index_unlock();
+    cmd_snapshot_release(snap);
+}
+
+typedef struct cmd_match_s {
+    long score;
+    const char* name;
+} cmd_match_t;
+
+static int cmd_match_compare(const void* p1, const void* p2) {
+    const cmd_match_t* m1 = (const cmd_match_t*)p1;
+    const cmd_match_t* m2 = (const cmd_match_t*)p2;
+    if (m1->score != m2->score)
+        return (m1->score > m2->score ? -1 : 1);
+    return strcmp(m1->name, m2->name);
+}
+
+// fuzzy match all commands and add the best scoring ones first
+static void command_complete_fuzzy(ic_completion_env_t* cenv, cmd_snapshot_t* snap,
+                                   const char* prefix) {
+    alloc_t* mem = cenv->env->mem;
+    const ssize_t plen = ic_strlen(prefix);
+    cmd_match_t* matches = NULL;
+    ssize_t count = 0;
+    ssize_t capacity = 0;
+    for (ssize_t i = 0; i < snap->count; i++) {
+        const char* name = snap->names[i];
+        const long score = fuzzy_score(prefix, plen, name, ic_strlen(name));
+        if (score < 0)
+            continue;
+        if (count >= capacity) {
+            ssize_t newcap = (capacity <= 0 ? 64 : 2 * capacity);
+            cmd_match_t* newmatches = mem_realloc_tp(mem, cmd_match_t, matches, newcap);
+            if (newmatches == NULL)
+                break;
+            matches = newmatches;
+            capacity = newcap;
+        }
+        matches[count].score = score;
+        matches[count].name = name;
+        count++;
+    }
+    if (count > 0) {
+        qsort(matches, to_size_t(count), sizeof(matches[0]), &cmd_match_compare);
+    }
+    for (ssize_t i = 0; i < count; i++) {
+        if (!ic_add_completion_ex(cenv, matches[i].name, NULL, NULL))
+            break;
+    }
+    mem_free(mem, matches);
+}
+
+static void command_completer(ic_completion_env_t* cenv, const char* prefix) {
+    if (prefix == NULL || strchr(prefix, '/') != NULL)
+        return;  // paths are not looked up in `$PATH`
+    const char* path_env = getenv("PATH");
+    if (path_env == NULL || path_env[0] == 0)
+        return;
+    cmd_snapshot_t* snap = cmd_index_acquire(cenv->env->mem, path_env);
+    if (snap == NULL)
+        return;
+    if (cenv->env->fuzzy) {
+        command_complete_fuzzy(cenv, snap, prefix);
+        cmd_snapshot_release(snap);
+        return;
+    }
+    // binary search the first name >= prefix
+    ssize_t lo = 0;
+    ssize_t hi = snap->count;
+    while (lo < hi) {
+        const ssize_t mid = lo + (hi - lo) / 2;
+        if (strcmp(snap->names[mid], prefix) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const size_t plen = strlen(prefix);
+    for (ssize_t i = lo; i < snap->count && strncmp(snap->names[i], prefix, plen) == 0; i++) {
+        if (!ic_add_completion_ex(cenv, snap->names[i], NULL, NULL))
+            break;
+    }
+    cmd_snapshot_release(snap);
+}
+
+ic_public void ic_complete_command(ic_completion_env_t* cenv, const char* prefix) {
+    ic_complete_qword_ex(cenv, prefix, &command_completer, &ic_char_is_filename_letter, '\\',
+                         "'\"");
+}
+
+#else
+
+ic_private void cmd_index_free(void) {}
+
+ic_public void ic_complete_command(ic_completion_env_t* cenv, const char* prefix) {
+    // no index on Windows: complete executables in the `PATH` directories directly
+    const char* path_env = getenv("PATH");
+    if (path_env == NULL)
+        return;
+    ic_complete_filename(cenv, prefix, 0, path_env, ".exe;.com;.bat;.cmd");
+}
+
+#endif
+
+//-------------------------------------------------------------
+// Forking
+// The completer helper process is forked while parallel
+// completions or a background refresh of the command index may
+// hold the locks of the shared state. The locks are taken around
+// the fork so the child gets a consistent copy; the child then
+// drops what belongs to threads it does not have: the inotify
+// descriptor (shared with the parent, whose events it must not
+// consume) and a command index refresh in progress.
+//-------------------------------------------------------------
+#if !defined(_WIN32) && defined(IC_USE_THREADS)
+
+static void completers_fork_prepare(void) {
+    dircache_lock();
+    cmd_index_lock();
+}
+
+static void completers_fork_parent(void) {
+    cmd_index_unlock();
+    dircache_unlock();
+}
+
+static void completers_fork_child(void) {
+    if (dircache.inotify_fd >= 0) {
+        close(dircache.inotify_fd);
+        dircache.inotify_fd = -1;
+    }
+    for (ssize_t i = 0; i < IC_DIRCACHE_MAX; i++) {
+        if (dircache.listings[i] != NULL)
+            dircache.listings[i]->wd = -1;  // validated by the modification time only
+    }
+    if (cmd_index.refreshing) {
+        // the refreshing thread does not exist here: abandon its (partial) state
+        cmd_index.refreshing = false;
+        cmd_index.checked = 0;
+        cmd_index.dirs = NULL;
+        cmd_index.dir_count = 0;
+        cmd_index.path_env = NULL;
+    }
+    pthread_cond_init(&cmd_index_cond, NULL);  // may have had waiters in the parent
+    cmd_index_unlock();
+    dircache_unlock();
+}
+
+static pthread_once_t completers_atfork_once = PTHREAD_ONCE_INIT;
+
+static void completers_atfork_register(void) {
+    pthread_atfork(&completers_fork_prepare, &completers_fork_parent, &completers_fork_child);
+}
+
+// register the fork handlers (once); called before forking a completer helper
+ic_private void completers_atfork(void) {
+    pthread_once(&completers_atfork_once, &completers_atfork_register);
+}
+
+#else
+
+ic_private void completers_atfork(void) {}
+
+#endif
+
+//-------------------------------------------------------------
+// Word lists
+// A word list is sorted on the case-folded words and front
+// coded in blocks of `IC_WORDLIST_BLOCK` words: the first word
+// of a block is stored in full, and every following word as the
+// length of the prefix it shares with its predecessor followed
+// by the rest of the word. Completion binary searches the block
+// heads and only decodes the blocks of the matching range.
+//-------------------------------------------------------------
+
+#define IC_WORDLIST_BLOCK (16)
+
+struct ic_wordlist_s {
+    alloc_t mem;    // copy of the allocator
+    ssize_t count;  // number of (unique) words
+    ssize_t block_count;
+    ssize_t* blocks;        // offset in `data` of the first word of each block
+    char* data;             // the front-coded words
+    ssize_t max_block_len;  // maximal length of a decoded block (including the terminators)
+};
+
+// compare case-folded (`plen` < 0 compares the whole word, otherwise only its prefix)
+static int wordlist_compare_n(const char* word, const char* s, ssize_t plen) {
+    for (ssize_t i = 0; plen < 0 || i < plen; i++) {
+        const unsigned char c1 = (unsigned char)ic_tolower(word[i]);
+        const unsigned char c2 = (unsigned char)ic_tolower(s[i]);
+        if (c1 != c2)
+            return (c1 < c2 ? -1 : 1);
+        if (c1 == 0)
+            break;
+    }
+    return 0;
+}
+
+static int wordlist_compare(const void* p1, const void* p2) {
+    const char* s1 = *(const char* const*)p1;
+    const char* s2 = *(const char* const*)p2;
+    const int c = wordlist_compare_n(s1, s2, -1);
+    return (c != 0 ? c : strcmp(s1, s2));
+}
+
+ic_public ic_wordlist_t* ic_wordlist_new(const char** words) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL || words == NULL)
+        return NULL;
+    ssize_t n = 0;
+    ssize_t total = 0;
+    while (words[n] != NULL) {
+        total += ic_strlen(words[n]) + 2;  // an upper bound of the coded length
+        n++;
+    }
+    ic_wordlist_t* wl = mem_zalloc_tp(env->mem, ic_wordlist_t);
+    const char** sorted = mem_malloc_tp_n(env->mem, const char*, n + 1);
+    if (wl == NULL || sorted == NULL) {
+        mem_free(env->mem, wl);
+        mem_free(env->mem, sorted);
+        return NULL;
+    }
+    wl->mem = *env->mem;
+    ic_memcpy((void*)sorted, (const void*)words, n * ssizeof(const char*));
+    if (n > 1) {
+        qsort((void*)sorted, to_size_t(n), sizeof(sorted[0]), &wordlist_compare);
+    }
+    wl->data = mem_malloc_tp_n(&wl->mem, char, total + 1);
+    wl->blocks = mem_malloc_tp_n(&wl->mem, ssize_t, (n / IC_WORDLIST_BLOCK) + 1);
+    if (wl->data == NULL || wl->blocks == NULL) {
+        mem_free(env->mem, sorted);
+        ic_wordlist_free(wl);
+        return NULL;
+    }
+    ssize_t ofs = 0;
+    ssize_t block_len = 0;
+    const char* prev = NULL;
+    for (ssize_t i = 0; i < n; i++) {
+        const char* word = sorted[i];
+        if (prev != NULL && strcmp(prev, word) == 0)
+            continue;  // duplicate
+        const ssize_t len = ic_strlen(word);
+        ssize_t shared = 0;
+        if (wl->count % IC_WORDLIST_BLOCK == 0) {
+            wl->blocks[wl->block_count++] = ofs;
+            block_len = 0;
+        } else {
+            while (shared < 255 && prev[shared] != 0 && prev[shared] == word[shared]) {
+                shared++;
+            }
+            wl->data[ofs++] = (char)shared;
+        }
+        ic_memcpy(wl->data + ofs, word + shared, len - shared + 1);
+        ofs += len - shared + 1;
+        block_len += len + 1;
+        if (block_len > wl->max_block_len)
+            wl->max_block_len = block_len;
+        wl->count++;
+        prev = word;
+    }
+    mem_free(env->mem, sorted);
+    return wl;
+}
+
+ic_public void ic_wordlist_free(ic_wordlist_t* wl) {
+    if (wl == NULL)
+        return;
+    alloc_t mem = wl->mem;
+    mem_free(&mem, wl->blocks);
+    mem_free(&mem, wl->data);
+    mem_free(&mem, wl);
+}
+
+// decode block `b` into `buf` and set `items`; returns the number of words
+static ssize_t wordlist_decode(const ic_wordlist_t* wl, ssize_t b, char* buf,
+                               ic_completion_item_t* items) {
+    const char* p = wl->data + wl->blocks[b];
+    const ssize_t n = (b == wl->block_count - 1 ? wl->count - b * IC_WORDLIST_BLOCK
+                                                : IC_WORDLIST_BLOCK);
+    const char* prev = NULL;
+    for (ssize_t i = 0; i < n; i++) {
+        ssize_t shared = 0;
+        if (i > 0) {
+            shared = (unsigned char)(*p++);
+            ic_memcpy(buf, prev, shared);
+        }
+        const ssize_t rest = ic_strlen(p);
+        ic_memcpy(buf + shared, p, rest + 1);
+        p += rest + 1;
+        memset(&items[i], 0, sizeof(items[i]));
+        items[i].replacement = buf;
+        items[i].replacement_len = (long)(shared + rest);
+        prev = buf;
+        buf += shared + rest + 1;
+    }
+    return n;
+}
+
+ic_public bool ic_complete_wordlist(ic_completion_env_t* cenv, const char* prefix,
+                                   const ic_wordlist_t* wl) {
+    if (cenv == NULL || prefix == NULL || wl == NULL || wl->count <= 0)
+        return true;
+    alloc_t* mem = cenv->env->mem;
+    char* buf = mem_malloc_tp_n(mem, char, wl->max_block_len);
+    if (buf == NULL)
+        return false;
+    ic_completion_item_t items[IC_WORDLIST_BLOCK];
+    bool cont = true;
+    if (cenv->env->fuzzy) {
+        // fuzzy matches are not contiguous: test every word
+        for (ssize_t b = 0; cont && b < wl->block_count; b++) {
+            const ssize_t n = wordlist_decode(wl, b, buf, items);
+            cont = ic_add_completions_n(cenv, prefix, items, (long)n, false);
+        }
+        mem_free(mem, buf);
+        return cont;
+    }
+    // binary search the first block whose head is not below the prefix;
+    // the matching words start in the block before it (or in that block)
+    ssize_t lo = 0;
+    ssize_t hi = wl->block_count;
+    while (lo < hi) {
+        const ssize_t mid = lo + (hi - lo) / 2;
+        if (wordlist_compare_n(wl->data + wl->blocks[mid], prefix, -1) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    const ssize_t plen = ic_strlen(prefix);
+    for (ssize_t b = (lo > 0 ? lo - 1 : 0); cont && b < wl->block_count; b++) {
+        const ssize_t n = wordlist_decode(wl, b, buf, items);
+        ssize_t start = 0;
+        while (start < n && wordlist_compare_n(items[start].replacement, prefix, plen) < 0) {
+            start++;
+        }
+        ssize_t end = start;
+        while (end < n && wordlist_compare_n(items[end].replacement, prefix, plen) == 0) {
+            end++;
+        }
+        if (end > start) {
+            cont = ic_add_completions_n(cenv, prefix, items + start, (long)(end - start), true);
+        }
+        if (end < n)
+            break;  // past the matching range
+    }
+    mem_free(mem, buf);
+    return cont;
+}
+
+//-------------------------------------------------------------
+// Completion dictionaries
+// An immutable on-disk dictionary (see `ic_dict_write`) that is
+// memory mapped read-only, so processes share its pages and
+// queries run directly against the mapping. The layout (in the
+// native byte order) is:
+//
+//   header   magic "ICDT", version, byte order mark, count
+//   index    257 x uint32: first entry of each (folded) first byte
+//   entries  count x 3 x uint32: offsets of the word, display, and help
+//   strings  0 terminated strings (offset 0 is the empty string)
+//
+// The entries are sorted on the case-folded words (as word lists).
+//-------------------------------------------------------------
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+#define IC_DICT_VERSION (1)
+#define IC_DICT_BOM (0x01020304)
+#define IC_DICT_HEADER (4)  // header size in uint32's
+#define IC_DICT_INDEX (257)
+
+struct ic_dict_s {
+    alloc_t mem;  // copy of the allocator
+    const char* data;
+    size_t size;
+    bool mapped;  // is `data` mapped (or read into memory)?
+    uint32_t count;
+    const uint32_t* index;
+    const uint32_t* entries;
+};
+
+typedef struct dict_entry_s {
+    const char* word;
+    const char* display;
+    const char* help;
+} dict_entry_t;
+
+static int dict_entry_compare(const void* p1, const void* p2) {
+    return wordlist_compare(&((const dict_entry_t*)p1)->word, &((const dict_entry_t*)p2)->word);
+}
+
+// add string `s` to the string table of length `*len`; returns its offset
+static uint32_t dict_add_string(char* strings, ssize_t* len, const char* s) {
+    if (s == NULL || s[0] == 0)
+        return 0;
+    const uint32_t ofs = (uint32_t)(*len);
+    const ssize_t n = ic_strlen(s) + 1;
+    ic_memcpy(strings + *len, s, n);
+    *len += n;
+    return ofs;
+}
+
+static ssize_t dict_strlen(const char* s) {
+    return (s == NULL ? 0 : ic_strlen(s) + 1);
+}
+
+ic_public bool ic_dict_write(const char* path, const char** words, const char** displays,
+                             const char** helps) {
+    if (path == NULL || words == NULL)
+        return false;
+    // use the C allocator: this needs no environment (which would set up the terminal)
+    alloc_t alloc = {&malloc, &realloc, &free};
+    alloc_t* mem = &alloc;
+    ssize_t n = 0;
+    ssize_t total = 1;  // an upper bound of the length of the string table
+    for (; words[n] != NULL; n++) {
+        total += dict_strlen(words[n]);
+        total += dict_strlen(displays != NULL ? displays[n] : NULL);
+        total += dict_strlen(helps != NULL ? helps[n] : NULL);
+    }
+    dict_entry_t* entries = mem_malloc_tp_n(mem, dict_entry_t, n + 1);
+    uint32_t* table = mem_zalloc_tp_n(mem, uint32_t, IC_DICT_HEADER + IC_DICT_INDEX + 3 * n);
+    char* strings = mem_malloc_tp_n(mem, char, total);
+    ssize_t len = 0;
+    char* tmp_path = mem_malloc_tp_n(mem, char, ic_strlen(path) + 5);
+    bool ok = (entries != NULL && table != NULL && strings != NULL && tmp_path != NULL);
+    if (ok) {
+        for (ssize_t i = 0; i < n; i++) {
+            entries[i].word = words[i];
+            entries[i].display = (displays != NULL ? displays[i] : NULL);
+            entries[i].help = (helps != NULL ? helps[i] : NULL);
+        }
+        if (n > 1) {
+            qsort(entries, to_size_t(n), sizeof(entries[0]), &dict_entry_compare);
+        }
+        strings[len++] = 0;  // offset 0 is the empty string
+        uint32_t* index = table + IC_DICT_HEADER;
+        uint32_t* ents = index + IC_DICT_INDEX;
+        uint32_t count = 0;
+        for (ssize_t i = 0; i < n; i++) {
+            if (count > 0 && strcmp(entries[i].word, entries[i - 1].word) == 0)
+                continue;  // duplicate
+            const unsigned char c = (unsigned char)ic_tolower(entries[i].word[0]);
+            index[c + 1] = count + 1;  // becomes the end of bucket `c`
+            ents[3 * count] = dict_add_string(strings, &len, entries[i].word);
+            ents[3 * count + 1] = dict_add_string(strings, &len, entries[i].display);
+            ents[3 * count + 2] = dict_add_string(strings, &len, entries[i].help);
+            count++;
+        }
+        for (ssize_t c = 1; c < IC_DICT_INDEX; c++) {
+            if (index[c] < index[c - 1])
+                index[c] = index[c - 1];  // an empty bucket
+        }
+        // offsets are relative to the start of the file
+        const uint32_t base = (uint32_t)(ssizeof(uint32_t) * (IC_DICT_HEADER + IC_DICT_INDEX +
+                                                              3 * (ssize_t)count));
+        for (uint32_t i = 0; i < 3 * count; i++) {
+            ents[i] += base;
+        }
+        ic_memcpy(table, "ICDT", 4);
+        table[1] = IC_DICT_VERSION;
+        table[2] = IC_DICT_BOM;
+        table[3] = count;
+        ok = (len < (ssize_t)(UINT32_MAX - base));
+        // write to a temporary file first: processes may have the current one mapped
+        snprintf(tmp_path, to_size_t(ic_strlen(path) + 5), "%s.tmp", path);
+        FILE* f = (ok ? fopen(tmp_path, "wb") : NULL);
+        if (f == NULL) {
+            ok = false;
+        } else {
+            ok = (fwrite(table, sizeof(uint32_t), (size_t)base / sizeof(uint32_t), f) ==
+                      (size_t)base / sizeof(uint32_t) &&
+                  fwrite(strings, 1, to_size_t(len), f) == to_size_t(len));
+            ok = (fclose(f) == 0 && ok);
+            if (ok) {
+                ok = (rename(tmp_path, path) == 0);
+            }
+            if (!ok) {
+                remove(tmp_path);
+            }
+        }
+    }
+    mem_free(mem, entries);
+    mem_free(mem, table);
+    mem_free(mem, strings);
+    mem_free(mem, tmp_path);
+    return ok;
+}
+
+ic_public ic_dict_t* ic_dict_open(const char* path) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL || path == NULL)
+        return NULL;
+    ic_dict_t* dict = mem_zalloc_tp(env->mem, ic_dict_t);
+    if (dict == NULL)
+        return NULL;
+    dict->mem = *env->mem;
+#if !defined(_WIN32)
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            dict->data = (const char*)p;
+            dict->size = (size_t)st.st_size;
+            dict->mapped = true;
+        }
+    }
+    if (fd >= 0)
+        close(fd);
+#else
+    FILE* f = fopen(path, "rb");
+    if (f != NULL) {
+        if (fseek(f, 0, SEEK_END) == 0) {
+            const long size = ftell(f);
+            char* buf = (size > 0 ? mem_malloc_tp_n(env->mem, char, size) : NULL);
+            if (buf != NULL && fseek(f, 0, SEEK_SET) == 0 &&
+                fread(buf, 1, (size_t)size, f) == (size_t)size) {
+                dict->data = buf;
+                dict->size = (size_t)size;
+            } else {
+                mem_free(env->mem, buf);
+            }
+        }
+        fclose(f);
+    }
+#endif
+    // validate the header and index; a final 0 terminates any string
+    const uint32_t* header = (const uint32_t*)dict->data;
+    const size_t fixed = sizeof(uint32_t) * (IC_DICT_HEADER + IC_DICT_INDEX);
+    bool ok = (dict->data != NULL && dict->size > fixed && dict->data[dict->size - 1] == 0 &&
+               memcmp(header, "ICDT", 4) == 0 && header[1] == IC_DICT_VERSION &&
+               header[2] == IC_DICT_BOM);
+    if (ok) {
+        dict->count = header[3];
+        dict->index = header + IC_DICT_HEADER;
+        dict->entries = dict->index + IC_DICT_INDEX;
+        ok = ((dict->size - fixed) / (3 * sizeof(uint32_t)) >= dict->count &&
+              dict->index[0] == 0 && dict->index[IC_DICT_INDEX - 1] == dict->count);
+        for (ssize_t c = 1; ok && c < IC_DICT_INDEX; c++) {
+            ok = (dict->index[c - 1] <= dict->index[c]);
+        }
+    }
+    if (!ok) {
+        debug_msg("completion: invalid dictionary: %s\n", path);
+        ic_dict_close(dict);
+        return NULL;
+    }
+    return dict;
+}
+
+ic_public void ic_dict_close(ic_dict_t* dict) {
+    if (dict == NULL)
+        return;
+    alloc_t mem = dict->mem;
+#if !defined(_WIN32)
+    if (dict->mapped) {
+        munmap((void*)dict->data, dict->size);
+    }
+#else
+    mem_free(&mem, dict->data);
+#endif
+    mem_free(&mem, dict);
+}
+
+// the string at offset `ofs` (or NULL if out of range or empty)
+static const char* dict_string(const ic_dict_t* dict, uint32_t ofs) {
+    if (ofs >= dict->size || dict->data[ofs] == 0)
+        return NULL;
+    return dict->data + ofs;
+}
+
+#define IC_DICT_BATCH (64)
+
+// add the entries from `lo` until `hi`, or until one does not match `prefix` if `plen >= 0`
+static bool dict_add_range(ic_completion_env_t* cenv, const char* prefix, ssize_t plen,
+                           const ic_dict_t* dict, uint32_t lo, uint32_t hi) {
+    ic_completion_item_t items[IC_DICT_BATCH];
+    const bool fuzzy = (plen < 0);
+    while (lo < hi) {
+        ssize_t n = 0;
+        bool done = false;
+        for (; lo < hi && n < IC_DICT_BATCH; lo++) {
+            const uint32_t* entry = dict->entries + (3 * (size_t)lo);
+            const char* word = dict_string(dict, entry[0]);
+            if (word == NULL)
+                continue;
+            if (!fuzzy && wordlist_compare_n(word, prefix, plen) != 0) {
+                done = true;  // past the matching range
+                break;
+            }
+            items[n].replacement = word;
+            items[n].replacement_len = -1;
+            items[n].display = dict_string(dict, entry[1]);
+            items[n].display_len = -1;
+            items[n].help = dict_string(dict, entry[2]);
+            items[n].help_len = -1;
+            n++;
+        }
+        if (n > 0 && !ic_add_completions_n(cenv, prefix, items, (long)n, !fuzzy))
+            return false;
+        if (done)
+            break;
+    }
+    return true;
+}
+
+ic_public bool ic_complete_dict(ic_completion_env_t* cenv, const char* prefix,
+                                const ic_dict_t* dict) {
+    if (cenv == NULL || prefix == NULL || dict == NULL || dict->count == 0)
+        return true;
+    if (cenv->env->fuzzy) {
+        return dict_add_range(cenv, prefix, -1, dict, 0, dict->count);
+    }
+    if (prefix[0] == 0) {
+        return dict_add_range(cenv, prefix, 0, dict, 0, dict->count);
+    }
+    // the bucket of the first character, and a binary search in it for the first match
+    const unsigned char c = (unsigned char)ic_tolower(prefix[0]);
+    uint32_t lo = dict->index[c];
+    uint32_t hi = dict->index[c + 1];
+    const uint32_t end = hi;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        const char* word = dict_string(dict, dict->entries[3 * (size_t)mid]);
+        if (word == NULL || wordlist_compare_n(word, prefix, -1) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return dict_add_range(cenv, prefix, ic_strlen(prefix), dict, lo, end);
+}
@@ -11,16 +11,32 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "common.h"
 #include "env.h"
+#include "frecency.h"
+#include "fuzzy.h"
 #include "isocline.h"
 #include "stringbuf.h"
 
+#if !defined(_WIN32) && !defined(IC_NO_FORK)
+#define IC_COMPLETER_HELPER
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 //-------------------------------------------------------------
 // Completions
 //-------------------------------------------------------------
 
+#define IC_INTERRUPT_POLL (5)  // milliseconds between polls of an interrupt
+
 typedef struct completion_s {
     const char* replacement;
     const char* display;
@@ -28,19 +44,75 @@ typedef struct completion_s {
     const char* source;
     ssize_t delete_before;
     ssize_t delete_after;
+    long score;              // fuzzy score (0 if fuzzy matching is disabled)
+    bool prefix_match;       // does the replacement start with the replaced text?
+    completion_cell_t cell;  // cached menu rendering
+    uint8_t borrowed;        // `COMPLETION_BORROWED_*` bits of the strings owned by the caller
+    bool plain;              // is `display` plain text (styled by `attr`) instead of bbcode?
+    attr_t attr;
+    int priority;            // priority of the source (or of the provider) for deduplication
 } completion_t;
 
+#define COMPLETION_BORROWED_REPLACEMENT (1)
+#define COMPLETION_BORROWED_DISPLAY (2)
+#define COMPLETION_BORROWED_HELP (4)
+
+// A named completion provider (see `ic_add_completion_provider`)
+typedef struct completion_provider_s {
+    char* name;
+    ic_completer_fun_t* completer;
+    void* arg;
+    int priority;
+    long budget_ms;  // time budget (or 0 for none)
+} completion_provider_t;
+
 struct completions_s {
     ic_completer_fun_t* completer;
     void* completer_arg;
     ssize_t completer_max;
+    long long deadline;  // wall-clock deadline of the generation in milliseconds (or 0 for none)
+    bool partial;        // was the generation cut short by its deadline?
+    bool (*interrupt)(void* arg);  // stops the generation early (see `completions_set_interrupt`)
+    void* interrupt_arg;
+    long long interrupt_next;  // time of the next poll of `interrupt`
     ssize_t count;
     ssize_t len;
     completion_t* elems;
     alloc_t* mem;
+    ssize_t sorted;            // number of leading entries that are in sorted order
+    // deduplication index on `replacement` (open addressing; 0 is empty, otherwise `index + 1`)
+    bool index_valid;
+    ssize_t* index;
+    ssize_t index_len;  // a power of 2
+    // strings passed to `ic_add_completion_borrowed` that may be stored without a copy
+    const char* borrow_replacement;
+    const char* borrow_display;
+    const char* borrow_help;
+    // plain display (and its style) of the next completion (see `completions_set_style`)
+    const char* style_display;
+    attr_t style_attr;
+    bool completer_monotonic;  // is the completer prefix-monotonic? (enables narrowing)
+    // narrowing cache: `elems` as generated for `cache_input` with the cursor at `cache_pos`
+    bool cache_valid;
+    bool cache_complete;  // was the completer not cut short by `completer_max`?
+    ic_completer_fun_t* cache_completer;
+    void* cache_arg;
+    char* cache_input;
+    ssize_t cache_pos;
+    // providers that run concurrently with the completer
+    completion_provider_t* providers;
+    ssize_t provider_count;
+    // ranking by accepted completions (created on demand)
+    frecency_t* frecency;
+    uint64_t context;  // context of the current completions (see `frecency_context`)
+    // run the completer in a helper process (see `ic_set_completer_isolated`)
+    bool isolated;
+    long isolated_timeout_ms;  // time limit of the helper (the budget may be shorter)
+    struct completer_helper_s* helper;
 };
 
 static void default_filename_completer(ic_completion_env_t* cenv, const char* prefix);
+static void completer_helper_stop(completions_t* cms);
 
 ic_private completions_t* completions_new(alloc_t* mem) {
     completions_t* cms = mem_zalloc_tp(mem, completions_t);
@@ -48,9 +120,16 @@ ic_private completions_t* completions_new(alloc_t* mem) {
         return NULL;
     cms->mem = mem;
     cms->completer = &default_filename_completer;
+    cms->completer_monotonic = true;
     return cms;
 }
 
+static void completions_cache_invalidate(completions_t* cms) {
+    cms->cache_valid = false;
+    mem_free(cms->mem, cms->cache_input);
+    cms->cache_input = NULL;
+}
+
 ic_private void completions_free(completions_t* cms) {
     if (cms == NULL)
         return;
@@ -61,168 +140,317 @@ ic_private void completions_free(completions_t* cms) {
         cms->count = 0;
         cms->len = 0;
     }
+    completions_cache_invalidate(cms);
+    mem_free(cms->mem, cms->index);
+    for (ssize_t i = 0; i < cms->provider_count; i++) {
+        mem_free(cms->mem, cms->providers[i].name);
+    }
+    mem_free(cms->mem, cms->providers);
+    frecency_free(cms->frecency);
+    completer_helper_stop(cms);
     mem_free(cms->mem, cms);  // free ourselves
 }
 
-ic_private void completions_clear(completions_t* cms) {
-    while (cms->count > 0) {
-        completion_t* cm = cms->elems + cms->count - 1;
+// Source priority levels (higher number = higher priority)
+typedef enum {
+    SOURCE_PRIORITY_HISTORY = 0,  // Lowest priority - history should never override other sources
+    SOURCE_PRIORITY_UNKNOWN = 1,
+    SOURCE_PRIORITY_FILE = 2,
+    SOURCE_PRIORITY_PLUGIN = 3,
+    SOURCE_PRIORITY_FUNCTION = 4
+} source_priority_t;
+
+// Helper function to get priority for a source string
+static source_priority_t get_source_priority(const char* source) {
+    if (!source)
+        return SOURCE_PRIORITY_UNKNOWN;
+
+    if (strcmp(source, "history") == 0)
+        return SOURCE_PRIORITY_HISTORY;
+    if (strcmp(source, "file") == 0)
+        return SOURCE_PRIORITY_FILE;
+    if (strcmp(source, "plugin") == 0)
+        return SOURCE_PRIORITY_PLUGIN;
+    if (strcmp(source, "function") == 0)
+        return SOURCE_PRIORITY_FUNCTION;
+
+    return SOURCE_PRIORITY_UNKNOWN;
+}
+
+static void completion_cell_clear(completion_cell_t* cell) {
+    sbuf_free(cell->text);
+    attrbuf_free(cell->attrs);
+    memset(cell, 0, sizeof(*cell));
+}
+
+static void completion_free_entry(completions_t* cms, completion_t* cm) {
+    completion_cell_clear(&cm->cell);
+    if (!(cm->borrowed & COMPLETION_BORROWED_DISPLAY))
         mem_free(cms->mem, cm->display);
+    if (!(cm->borrowed & COMPLETION_BORROWED_REPLACEMENT))
         mem_free(cms->mem, cm->replacement);
+    if (!(cm->borrowed & COMPLETION_BORROWED_HELP))
         mem_free(cms->mem, cm->help);
-        mem_free(cms->mem, cm->source);
-        memset(cm, 0, sizeof(*cm));
+    mem_free(cms->mem, cm->source);
+    memset(cm, 0, sizeof(*cm));
+}
+
+ic_private void completions_clear(completions_t* cms) {
+    completions_cache_invalidate(cms);
+    cms->sorted = 0;
+    cms->index_valid = false;
+    while (cms->count > 0) {
+        completion_free_entry(cms, cms->elems + cms->count - 1);
         cms->count--;
     }
 }
 
-static bool completions_set_entry(completions_t* cms, completion_t* cm, const char* replacement,
-                                  const char* display, const char* help, const char* source,
-                                  ssize_t delete_before, ssize_t delete_after) {
-    char* new_replacement = NULL;
-    char* new_display = NULL;
-    char* new_help = NULL;
-    char* new_source = NULL;
+static char* completion_strdup(completions_t* cms, const char* s, long len) {
+    return (len < 0 ? mem_strdup(cms->mem, s) : mem_strndup(cms->mem, s, len));
+}
 
-    if (replacement != NULL) {
-        new_replacement = mem_strdup(cms->mem, replacement);
-        if (new_replacement == NULL)
-            goto fail;
-    }
-    if (display != NULL) {
-        new_display = mem_strdup(cms->mem, display);
-        if (new_display == NULL)
-            goto fail;
-    }
-    if (help != NULL) {
-        new_help = mem_strdup(cms->mem, help);
-        if (new_help == NULL)
-            goto fail;
+// copy `s` into `*out`, or store it as is if it is borrowed
+static bool completion_str(completions_t* cms, const char* s, long len, bool borrow,
+                           const char** out) {
+    if (s == NULL || borrow) {
+        *out = s;
+        return true;
     }
+    *out = completion_strdup(cms, s, len);
+    return (*out != NULL);
+}
+
+static bool completions_set_entry(completions_t* cms, completion_t* cm,
+                                  const ic_completion_item_t* item, const char* source,
+                                  ssize_t delete_before, ssize_t delete_after, uint8_t borrowed) {
+    const char* new_replacement = NULL;
+    const char* new_display = NULL;
+    const char* new_help = NULL;
+    char* new_source = NULL;
+
+    if (!completion_str(cms, item->replacement, item->replacement_len,
+                        (borrowed & COMPLETION_BORROWED_REPLACEMENT) != 0, &new_replacement))
+        goto fail;
+    if (!completion_str(cms, item->display, item->display_len,
+                        (borrowed & COMPLETION_BORROWED_DISPLAY) != 0, &new_display))
+        goto fail;
+    if (!completion_str(cms, item->help, item->help_len,
+                        (borrowed & COMPLETION_BORROWED_HELP) != 0, &new_help))
+        goto fail;
     if (source != NULL) {
         new_source = mem_strdup(cms->mem, source);
         if (new_source == NULL)
             goto fail;
     }
 
-    mem_free(cms->mem, cm->replacement);
-    mem_free(cms->mem, cm->display);
-    mem_free(cms->mem, cm->help);
-    mem_free(cms->mem, cm->source);
-
-    cm->replacement = (replacement != NULL ? new_replacement : NULL);
-    cm->display = (display != NULL ? new_display : NULL);
-    cm->help = (help != NULL ? new_help : NULL);
-    cm->source = (source != NULL ? new_source : NULL);
+    completion_free_entry(cms, cm);
+    cm->replacement = new_replacement;
+    cm->display = new_display;
+    cm->help = new_help;
+    cm->source = new_source;
+    cm->borrowed = borrowed;
     cm->delete_before = delete_before;
     cm->delete_after = delete_after;
+    cm->score = 0;
+    cm->prefix_match = true;
+    cm->plain = (cms->style_display != NULL && item->display == cms->style_display);
+    cm->attr = (cm->plain ? cms->style_attr : attr_none());
+    cm->priority = (int)get_source_priority(source);
     return true;
 
 fail:
-    mem_free(cms->mem, new_replacement);
-    mem_free(cms->mem, new_display);
-    mem_free(cms->mem, new_help);
+    if (!(borrowed & COMPLETION_BORROWED_REPLACEMENT))
+        mem_free(cms->mem, new_replacement);
+    if (!(borrowed & COMPLETION_BORROWED_DISPLAY))
+        mem_free(cms->mem, new_display);
+    if (!(borrowed & COMPLETION_BORROWED_HELP))
+        mem_free(cms->mem, new_help);
     mem_free(cms->mem, new_source);
     return false;
 }
 
-static bool completions_push(completions_t* cms, const char* replacement, const char* display,
-                             const char* help, const char* source, ssize_t delete_before,
-                             ssize_t delete_after) {
-    if (cms->count >= cms->len) {
-        ssize_t newlen = (cms->len <= 0 ? 32 : cms->len * 2);
-        completion_t* newelems = mem_realloc_tp(cms->mem, completion_t, cms->elems, newlen);
-        if (newelems == NULL)
-            return false;
-        cms->elems = newelems;
-        cms->len = newlen;
+static bool completions_reserve(completions_t* cms, ssize_t extra) {
+    if (cms->count + extra <= cms->len)
+        return true;
+    ssize_t newlen = (cms->len <= 0 ? 32 : cms->len * 2);
+    while (newlen < cms->count + extra) {
+        newlen *= 2;
     }
+    completion_t* newelems = mem_realloc_tp(cms->mem, completion_t, cms->elems, newlen);
+    if (newelems == NULL)
+        return false;
+    cms->elems = newelems;
+    cms->len = newlen;
+    return true;
+}
+
+static void completions_index_insert(completions_t* cms, ssize_t i);
+static void completions_index_rebuild(completions_t* cms);
+
+static bool completions_push(completions_t* cms, const ic_completion_item_t* item,
+                             const char* source, ssize_t delete_before, ssize_t delete_after,
+                             uint8_t borrowed) {
+    if (!completions_reserve(cms, 1))
+        return false;
     assert(cms->count < cms->len);
+    cms->sorted = 0;
     completion_t* cm = cms->elems + cms->count;
     memset(cm, 0, sizeof(*cm));
-    if (!completions_set_entry(cms, cm, replacement, display, help, source, delete_before,
-                               delete_after)) {
+    if (!completions_set_entry(cms, cm, item, source, delete_before, delete_after, borrowed)) {
         memset(cm, 0, sizeof(*cm));
         return false;
     }
     cms->count++;
+    if (cms->index_valid) {
+        if (2 * cms->count > cms->index_len) {
+            completions_index_rebuild(cms);
+        } else {
+            completions_index_insert(cms, cms->count - 1);
+        }
+    }
     return true;
 }
 
 ic_private ssize_t completions_count(completions_t* cms) {
     return cms->count;
 }
-// Source priority levels (higher number = higher priority)
-typedef enum {
-    SOURCE_PRIORITY_HISTORY = 0,  // Lowest priority - history should never override other sources
-    SOURCE_PRIORITY_UNKNOWN = 1,
-    SOURCE_PRIORITY_FILE = 2,
-    SOURCE_PRIORITY_PLUGIN = 3,
-    SOURCE_PRIORITY_FUNCTION = 4
-} source_priority_t;
 
-// Helper function to get priority for a source string
-static source_priority_t get_source_priority(const char* source) {
-    if (!source)
-        return SOURCE_PRIORITY_UNKNOWN;
+ic_private ssize_t completions_remaining(completions_t* cms) {
+    return cms->completer_max;
+}
 
-    if (strcmp(source, "history") == 0)
-        return SOURCE_PRIORITY_HISTORY;
-    if (strcmp(source, "file") == 0)
-        return SOURCE_PRIORITY_FILE;
-    if (strcmp(source, "plugin") == 0)
-        return SOURCE_PRIORITY_PLUGIN;
-    if (strcmp(source, "function") == 0)
-        return SOURCE_PRIORITY_FUNCTION;
+ic_private bool completions_is_partial(completions_t* cms) {
+    return cms->partial;
+}
 
-    return SOURCE_PRIORITY_UNKNOWN;
+ic_private void completions_set_interrupt(completions_t* cms, bool (*interrupt)(void* arg),
+                                          void* arg) {
+    cms->interrupt = interrupt;
+    cms->interrupt_arg = arg;
+    cms->interrupt_next = 0;
+}
+
+// is the generation past its deadline, or interrupted? (marks the completions as partial)
+static bool completions_out_of_time(completions_t* cms) {
+    if (cms->deadline <= 0)
+        return false;
+    if (!cms->partial) {
+        const long long now = ic_clock_ms();
+        if (now >= cms->deadline) {
+            debug_msg("completion: out of the time budget after %zd entries\n", cms->count);
+            cms->partial = true;
+        } else if (cms->interrupt != NULL && now >= cms->interrupt_next) {
+            cms->interrupt_next = now + IC_INTERRUPT_POLL;
+            if (cms->interrupt(cms->interrupt_arg)) {
+                debug_msg("completion: interrupted after %zd entries\n", cms->count);
+                cms->partial = true;
+            }
+        }
+    }
+    return cms->partial;
+}
+
+//-------------------------------------------------------------
+// Deduplication index
+// A hash set of the replacements so adding `n` completions takes
+// O(n) instead of O(n^2). It is built once there are enough
+// entries and rebuilt after the entries are reordered.
+//-------------------------------------------------------------
+
+#define IC_COMPLETIONS_INDEX_MIN (32)  // below this a linear search is faster
+
+static size_t completions_hash(const char* s, ssize_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;  // FNV-1a
+    for (ssize_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * 0x100000001b3ULL;
+    }
+    return (size_t)h;
+}
+
+static bool completion_replacement_eq(const completion_t* cm, const char* replacement,
+                                      ssize_t len) {
+    return (strncmp(cm->replacement, replacement, to_size_t(len)) == 0 &&
+            cm->replacement[len] == 0);
+}
+
+static void completions_index_insert(completions_t* cms, ssize_t i) {
+    const char* r = cms->elems[i].replacement;
+    const size_t mask = to_size_t(cms->index_len - 1);
+    size_t h = completions_hash(r, ic_strlen(r)) & mask;
+    while (cms->index[h] != 0) {
+        h = (h + 1) & mask;
+    }
+    cms->index[h] = i + 1;
+}
+
+static void completions_index_rebuild(completions_t* cms) {
+    cms->index_valid = false;
+    ssize_t len = 64;
+    while (len < 2 * cms->count) {
+        len *= 2;
+    }
+    if (len != cms->index_len) {
+        mem_free(cms->mem, cms->index);
+        cms->index_len = 0;
+        cms->index = mem_malloc_tp_n(cms->mem, ssize_t, len);
+        if (cms->index == NULL)
+            return;
+        cms->index_len = len;
+    }
+    ic_memset(cms->index, 0, len * ssizeof(ssize_t));
+    for (ssize_t i = 0; i < cms->count; i++) {
+        completions_index_insert(cms, i);
+    }
+    cms->index_valid = true;
 }
 
 // Find existing completion by replacement text, returns index or -1 if not
 // found
-static ssize_t completions_find(completions_t* cms, const char* replacement) {
-    for (ssize_t i = 0; i < cms->count; i++) {
-        const completion_t* c = cms->elems + i;
-        if (strcmp(replacement, c->replacement) == 0) {
-            return i;
+static ssize_t completions_find(completions_t* cms, const char* replacement, ssize_t len) {
+    if (!cms->index_valid && cms->count >= IC_COMPLETIONS_INDEX_MIN) {
+        completions_index_rebuild(cms);
+    }
+    if (!cms->index_valid) {
+        for (ssize_t i = 0; i < cms->count; i++) {
+            if (completion_replacement_eq(cms->elems + i, replacement, len))
+                return i;
         }
+        return -1;
+    }
+    const size_t mask = to_size_t(cms->index_len - 1);
+    size_t h = completions_hash(replacement, len) & mask;
+    while (cms->index[h] != 0) {
+        const ssize_t i = cms->index[h] - 1;
+        if (completion_replacement_eq(cms->elems + i, replacement, len))
+            return i;
+        h = (h + 1) & mask;
     }
     return -1;
 }
 
 // Replace an existing completion at the given index
-static bool completions_replace(completions_t* cms, ssize_t index, const char* replacement,
-                                const char* display, const char* help, const char* source,
-                                ssize_t delete_before, ssize_t delete_after) {
-    if (index < 0 || index >= cms->count)
-        return false;
-
-    completion_t* cm = &cms->elems[index];
-    return completions_set_entry(cms, cm, replacement, display, help, source, delete_before,
-                                 delete_after);
-}
-
-ic_private bool completions_add(completions_t* cms, const char* replacement, const char* display,
-                                const char* help, const char* source, ssize_t delete_before,
-                                ssize_t delete_after) {
-    if (cms->completer_max <= 0)
+// add a completion; the item lengths must be resolved (>= 0 for the replacement)
+static bool completions_add_item(completions_t* cms, const ic_completion_item_t* item,
+                                 const char* source, ssize_t delete_before, ssize_t delete_after,
+                                 uint8_t borrowed) {
+    if (cms->completer_max <= 0 || completions_out_of_time(cms))
         return false;
 
     // Check if this completion already exists
-    ssize_t existing_index = completions_find(cms, replacement);
+    ssize_t existing_index = completions_find(cms, item->replacement, item->replacement_len);
 
     cms->completer_max--;
 
     if (existing_index >= 0) {
         // Completion exists, check priority
-        const completion_t* existing = &cms->elems[existing_index];
-        source_priority_t existing_priority = get_source_priority(existing->source);
-        source_priority_t new_priority = get_source_priority(source);
+        completion_t* existing = &cms->elems[existing_index];
+        const int existing_priority = existing->priority;
+        const int new_priority = (int)get_source_priority(source);
 
         if (new_priority > existing_priority) {
             // Higher priority, replace the existing completion
-            if (!completions_replace(cms, existing_index, replacement, display, help, source,
-                                     delete_before, delete_after)) {
+            if (!completions_set_entry(cms, existing, item, source, delete_before, delete_after,
+                                       borrowed)) {
                 cms->completer_max++;
                 return false;
             }
@@ -230,13 +458,40 @@ ic_private bool completions_add(completions_t* cms, const char* replacement, con
         return true;
     }
 
-    if (!completions_push(cms, replacement, display, help, source, delete_before, delete_after)) {
+    if (!completions_push(cms, item, source, delete_before, delete_after, borrowed)) {
         cms->completer_max++;
         return false;
     }
     return true;
 }
 
+ic_private bool completions_add(completions_t* cms, const char* replacement, const char* display,
+                                const char* help, const char* source, ssize_t delete_before,
+                                ssize_t delete_after) {
+    if (replacement == NULL)
+        return false;
+    ic_completion_item_t item;
+    item.replacement = replacement;
+    item.replacement_len = (long)ic_strlen(replacement);
+    item.display = display;
+    item.display_len = -1;
+    item.help = help;
+    item.help_len = -1;
+    // store the strings of `ic_add_completion_borrowed` by pointer (unless a completion
+    // wrapper such as `ic_complete_qword` substituted a temporary)
+    uint8_t borrowed = 0;
+    if (cms->borrow_replacement != NULL) {
+        if (replacement == cms->borrow_replacement || replacement == cms->borrow_display)
+            borrowed |= COMPLETION_BORROWED_REPLACEMENT;
+        if (display != NULL &&
+            (display == cms->borrow_display || display == cms->borrow_replacement))
+            borrowed |= COMPLETION_BORROWED_DISPLAY;
+        if (help != NULL && help == cms->borrow_help)
+            borrowed |= COMPLETION_BORROWED_HELP;
+    }
+    return completions_add_item(cms, &item, source, delete_before, delete_after, borrowed);
+}
+
 static completion_t* completions_get(completions_t* cms, ssize_t index) {
     if (index < 0 || cms->count <= 0 || index >= cms->count)
         return NULL;
@@ -278,6 +533,27 @@ ic_private const char* completions_get_source(completions_t* cms, ssize_t index)
     return cm->source;
 }
 
+// Mark a completion added with the given `display` pointer as plain text styled with `attr`
+// (instead of bbcode); used for file names colored by LS_COLORS. Reset with a NULL `display`.
+ic_private void completions_set_style(completions_t* cms, const char* display, attr_t attr) {
+    cms->style_display = display;
+    cms->style_attr = attr;
+}
+
+// is the display plain text? if so, `*attr` is its style
+ic_private bool completions_get_style(completions_t* cms, ssize_t index, attr_t* attr) {
+    completion_t* cm = completions_get(cms, index);
+    *attr = (cm != NULL ? cm->attr : attr_none());
+    return (cm != NULL && cm->plain);
+}
+
+ic_private completion_cell_t* completions_get_cell(completions_t* cms, ssize_t index) {
+    completion_t* cm = completions_get(cms, index);
+    if (cm == NULL)
+        return NULL;
+    return &cm->cell;
+}
+
 ic_private const char* completions_get_hint(completions_t* cms, ssize_t index, const char** help) {
     if (help != NULL) {
         *help = NULL;
@@ -288,6 +564,8 @@ ic_private const char* completions_get_hint(completions_t* cms, ssize_t index, c
     ssize_t len = ic_strlen(cm->replacement);
     if (len < cm->delete_before)
         return NULL;
+    if (!cm->prefix_match)
+        return NULL;  // a fuzzy match cannot be shown as a hint
     const char* hint = (cm->replacement + cm->delete_before);
     if (*hint == 0 || utf8_is_cont((uint8_t)(*hint)))
         return NULL;  // utf8 boundary?
@@ -299,8 +577,21 @@ ic_private const char* completions_get_hint(completions_t* cms, ssize_t index, c
 
 ic_private void completions_set_completer(completions_t* cms, ic_completer_fun_t* completer,
                                           void* arg) {
+    completions_cache_invalidate(cms);
     cms->completer = completer;
     cms->completer_arg = arg;
+    cms->completer_monotonic = false;  // a new completer must declare this again
+}
+
+ic_private bool completions_set_monotonic(completions_t* cms, bool monotonic) {
+    bool prev = cms->completer_monotonic;
+    completions_cache_invalidate(cms);
+    cms->completer_monotonic = monotonic;
+    return prev;
+}
+
+ic_private bool completions_is_monotonic(completions_t* cms) {
+    return cms->completer_monotonic;
 }
 
 ic_private void completions_get_completer(completions_t* cms, ic_completer_fun_t** completer,
@@ -318,7 +609,24 @@ ic_public bool ic_has_completions(const ic_completion_env_t* cenv) {
 }
 
 ic_public bool ic_stop_completing(const ic_completion_env_t* cenv) {
-    return (cenv == NULL ? true : cenv->env->completions->completer_max <= 0);
+    if (cenv == NULL)
+        return true;
+    completions_t* cms = cenv->env->completions;
+    return (cms->completer_max <= 0 || completions_out_of_time(cms));
+}
+
+ic_private bool completions_match(struct ic_env_s* env, const char* candidate, const char* prefix) {
+    if (candidate == NULL || prefix == NULL)
+        return false;
+    if (env != NULL && env->fuzzy) {
+        return fuzzy_is_match(prefix, ic_strlen(prefix), candidate, ic_strlen(candidate));
+    }
+    return ic_istarts_with(candidate, prefix);
+}
+
+ic_public bool ic_completion_matches(const ic_completion_env_t* cenv, const char* candidate,
+                                     const char* prefix) {
+    return completions_match(cenv == NULL ? NULL : cenv->env, candidate, prefix);
 }
 
 static ssize_t completion_apply(completion_t* cm, stringbuf_t* sbuf, ssize_t pos) {
@@ -345,21 +653,198 @@ ic_private ssize_t completions_apply(completions_t* cms, ssize_t index, stringbu
     return completion_apply(cm, sbuf, pos);
 }
 
-static int completion_compare(const void* p1, const void* p2) {
-    if (p1 == NULL || p2 == NULL)
-        return 0;
-    const completion_t* cm1 = (const completion_t*)p1;
-    const completion_t* cm2 = (const completion_t*)p2;
-    return ic_stricmp(cm1->replacement, cm2->replacement);
+//-------------------------------------------------------------
+// Sorting
+// Completions are ordered by their rank (how often and how
+// recently they were accepted, descending), by fuzzy score
+// (descending), and then alphabetically (case-insensitively, where
+// a prefix of another string comes first). Each entry gets a
+// precomputed key once per sort so comparisons rarely need to
+// case fold the strings. Often only the first page
+// of the menu is visible: `completions_sort_top` then only selects
+// and orders the first `k` entries, and the remainder is sorted
+// lazily by `completions_sort`.
+//-------------------------------------------------------------
+
+typedef struct completion_key_s {
+    long rank;
+    long score;
+    ssize_t len;
+    uint64_t prefix;  // first 8 case folded bytes (so integer order is string order)
+    const char* replacement;
+    ssize_t index;
+} completion_key_t;
+
+static uint64_t completion_key_prefix(const char* s, ssize_t len) {
+    // `ic_strnicmp` compares `char`s, so flip the sign bit if `char` is signed
+    const uint8_t sign_flip = ((char)(-1) < 0 ? 0x80 : 0);
+    uint64_t key = 0;
+    for (ssize_t i = 0; i < 8; i++) {
+        const uint8_t c = (i < len ? (uint8_t)((uint8_t)ic_tolower(s[i]) ^ sign_flip) : 0);
+        key = (key << 8) | c;
+    }
+    return key;
+}
+
+static int completion_key_compare(const void* p1, const void* p2) {
+    const completion_key_t* k1 = (const completion_key_t*)p1;
+    const completion_key_t* k2 = (const completion_key_t*)p2;
+    if (k1->rank != k2->rank)
+        return (k1->rank > k2->rank ? -1 : 1);  // most often and recently accepted first
+    if (k1->score != k2->score)
+        return (k1->score > k2->score ? -1 : 1);  // best fuzzy match first
+    if (k1->prefix != k2->prefix)
+        return (k1->prefix < k2->prefix ? -1 : 1);
+    const ssize_t len = (k1->len < k2->len ? k1->len : k2->len);
+    if (len > 8) {
+        const int c = ic_strnicmp(k1->replacement + 8, k2->replacement + 8, len - 8);
+        if (c != 0)
+            return c;
+    }
+    if (k1->len != k2->len)
+        return (k1->len < k2->len ? -1 : 1);  // a prefix of the other comes first
+    return 0;
+}
+
+static void completion_key_swap(completion_key_t* keys, ssize_t i, ssize_t j) {
+    const completion_key_t tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+}
+
+// partition `keys` such that the first `k` keys are the `k` smallest (in any order)
+static void completion_keys_select(completion_key_t* keys, ssize_t n, ssize_t k) {
+    ssize_t lo = 0;
+    ssize_t hi = n - 1;
+    while (lo < hi) {
+        // median of three as the pivot (moved to `hi`)
+        const ssize_t mid = lo + (hi - lo) / 2;
+        if (completion_key_compare(&keys[mid], &keys[lo]) < 0)
+            completion_key_swap(keys, mid, lo);
+        if (completion_key_compare(&keys[hi], &keys[lo]) < 0)
+            completion_key_swap(keys, hi, lo);
+        if (completion_key_compare(&keys[mid], &keys[hi]) < 0)
+            completion_key_swap(keys, mid, hi);
+        ssize_t store = lo;
+        for (ssize_t i = lo; i < hi; i++) {
+            if (completion_key_compare(&keys[i], &keys[hi]) < 0) {
+                completion_key_swap(keys, i, store);
+                store++;
+            }
+        }
+        completion_key_swap(keys, store, hi);
+        if (store == k || store == k - 1)
+            return;
+        if (store < k)
+            lo = store + 1;
+        else
+            hi = store - 1;
+    }
+}
+
+// sort the entries `[start, count)` such that at least `[start, start+k)` is in order
+static void completions_sort_range(completions_t* cms, ssize_t start, ssize_t k) {
+    const ssize_t n = cms->count - start;
+    if (n <= 1 || k <= 0) {
+        cms->sorted = cms->count;
+        return;
+    }
+    completion_key_t* keys = mem_malloc_tp_n(cms->mem, completion_key_t, n);
+    completion_t* elems = mem_malloc_tp_n(cms->mem, completion_t, n);
+    if (keys == NULL || elems == NULL) {
+        mem_free(cms->mem, keys);
+        mem_free(cms->mem, elems);
+        return;
+    }
+    const frecency_t* fr = (frecency_is_empty(cms->frecency) ? NULL : cms->frecency);
+    const long long now = (long long)time(NULL);
+    for (ssize_t i = 0; i < n; i++) {
+        const completion_t* cm = cms->elems + start + i;
+        keys[i].rank = frecency_score(fr, cms->context, cm->replacement, now);
+        keys[i].score = cm->score;
+        keys[i].len = ic_strlen(cm->replacement);
+        keys[i].prefix = completion_key_prefix(cm->replacement, keys[i].len);
+        keys[i].replacement = cm->replacement;
+        keys[i].index = start + i;
+    }
+    if (k < n) {
+        completion_keys_select(keys, n, k);
+        qsort(keys, to_size_t(k), sizeof(keys[0]), &completion_key_compare);
+        cms->sorted = start + k;
+    } else {
+        qsort(keys, to_size_t(n), sizeof(keys[0]), &completion_key_compare);
+        cms->sorted = cms->count;
+    }
+    // and permute the entries
+    for (ssize_t i = 0; i < n; i++) {
+        elems[i] = cms->elems[keys[i].index];
+    }
+    ic_memcpy(cms->elems + start, elems, n * ssizeof(completion_t));
+    cms->index_valid = false;
+    mem_free(cms->mem, elems);
+    mem_free(cms->mem, keys);
+}
+
+// ensure the first `k` entries are sorted
+ic_private void completions_sort_top(completions_t* cms, ssize_t k) {
+    completions_cache_invalidate(cms);  // the cache relies on the completer order
+    if (k > cms->count)
+        k = cms->count;
+    if (cms->sorted >= k)
+        return;
+    completions_sort_range(cms, cms->sorted, k - cms->sorted);
 }
 
 ic_private void completions_sort(completions_t* cms) {
-    if (cms->count <= 0)
+    completions_sort_top(cms, cms->count);
+}
+
+ic_private bool completions_has_ranks(completions_t* cms) {
+    return !frecency_is_empty(cms->frecency);
+}
+
+// move the highest ranked entry to the front (if any entry was accepted before)
+ic_private void completions_rank_first(completions_t* cms) {
+    if (frecency_is_empty(cms->frecency) || cms->count <= 1)
         return;
-    qsort(cms->elems, to_size_t(cms->count), sizeof(cms->elems[0]), &completion_compare);
+    const long long now = (long long)time(NULL);
+    ssize_t best = -1;
+    long best_rank = 0;
+    for (ssize_t i = 0; i < cms->count; i++) {
+        const long rank =
+            frecency_score(cms->frecency, cms->context, cms->elems[i].replacement, now);
+        if (rank > best_rank) {
+            best = i;
+            best_rank = rank;
+        }
+    }
+    if (best > 0) {
+        completions_cache_invalidate(cms);  // the cache relies on the completer order
+        const completion_t cm = cms->elems[best];
+        ic_memmove(cms->elems + 1, cms->elems, best * ssizeof(completion_t));
+        cms->elems[0] = cm;
+        cms->sorted = 0;
+        cms->index_valid = false;
+    }
 }
 
-#define IC_MAX_PREFIX (256)
+// record that the entry at `index` is accepted (for ranking)
+ic_private void completions_accept(completions_t* cms, ssize_t index) {
+    completion_t* cm = completions_get(cms, index);
+    if (cm == NULL)
+        return;
+    if (cms->frecency == NULL) {
+        cms->frecency = frecency_new(cms->mem);
+    }
+    frecency_record(cms->frecency, cms->context, cm->replacement);
+}
+
+ic_private void completions_set_rank_file(completions_t* cms, const char* fname) {
+    if (cms->frecency == NULL) {
+        cms->frecency = frecency_new(cms->mem);
+    }
+    frecency_load_from(cms->frecency, fname);
+}
 
 // find longest common prefix and complete with that.
 ic_private ssize_t completions_apply_longest_prefix(completions_t* cms, stringbuf_t* sbuf,
@@ -370,44 +855,39 @@ ic_private ssize_t completions_apply_longest_prefix(completions_t* cms, stringbu
 
     // set initial prefix to the first entry
     completion_t* cm = completions_get(cms, 0);
-    if (cm == NULL)
+    if (cm == NULL || !cm->prefix_match)
         return -1;
 
-    char prefix[IC_MAX_PREFIX + 1];
+    const char* first = cm->replacement;
     ssize_t delete_before = cm->delete_before;
-    ic_strncpy(prefix, IC_MAX_PREFIX + 1, cm->replacement, IC_MAX_PREFIX);
-    prefix[IC_MAX_PREFIX] = 0;
+    ssize_t len = ic_strlen(first);
 
     // and visit all others to find the longest common prefix
-    for (ssize_t i = 1; i < cms->count; i++) {
+    for (ssize_t i = 1; i < cms->count && len > 0; i++) {
         cm = completions_get(cms, i);
-        if (cm->delete_before != delete_before) {  // deletions must match delete_before
-            prefix[0] = 0;
+        if (cm->delete_before != delete_before ||  // deletions must match delete_before
+            !cm->prefix_match) {                    // and fuzzy matches have no common prefix
+            len = 0;
             break;
         }
-        // check if it is still a prefix
-        const char* r = cm->replacement;
-        ssize_t j;
-        for (j = 0; prefix[j] != 0 && r[j] != 0; j++) {
-            if (prefix[j] != r[j])
-                break;
-        }
-        prefix[j] = 0;
-        if (j <= 0)
-            break;
+        len = str_common_prefix(first, len, cm->replacement, ic_strlen(cm->replacement));
     }
 
     // check the length
-    ssize_t len = ic_strlen(prefix);
     if (len <= 0 || len < delete_before)
         return -1;
+    char* prefix = mem_strndup(cms->mem, first, len);
+    if (prefix == NULL)
+        return -1;
 
     // we found a prefix :-)
+    completions_cache_invalidate(cms);  // we adjust `delete_before` below
     completion_t cprefix;
     memset(&cprefix, 0, sizeof(cprefix));
     cprefix.delete_before = delete_before;
     cprefix.replacement = prefix;
     ssize_t newpos = completion_apply(&cprefix, sbuf, pos);
+    mem_free(cms->mem, prefix);
     if (newpos < 0)
         return newpos;
 
@@ -427,7 +907,7 @@ ic_private ssize_t completions_apply_longest_prefix(completions_t* cms, stringbu
 ic_public bool ic_add_completions(ic_completion_env_t* cenv, const char* prefix,
                                   const char** completions) {
     for (const char** pc = completions; *pc != NULL; pc++) {
-        if (ic_istarts_with(*pc, prefix)) {
+        if (completions_match(cenv->env, *pc, prefix)) {
             if (!ic_add_completion_ex(cenv, *pc, NULL, NULL))
                 return false;
         }
@@ -435,6 +915,106 @@ ic_public bool ic_add_completions(ic_completion_env_t* cenv, const char* prefix,
     return true;
 }
 
+// does `s` (of length `slen`) match `prefix`? (see `completions_match`)
+static bool completions_match_n(ic_env_t* env, const char* s, ssize_t slen, const char* prefix,
+                                ssize_t plen) {
+    if (env != NULL && env->fuzzy) {
+        return fuzzy_is_match(prefix, plen, s, slen);
+    }
+    if (slen < plen)
+        return false;
+    for (ssize_t i = 0; i < plen; i++) {
+        if (ic_tolower(s[i]) != ic_tolower(prefix[i]))
+            return false;
+    }
+    return true;
+}
+
+static bool prim_add_completion(ic_env_t* env, void* funenv, const char* replacement,
+                                const char* display, const char* help, long delete_before,
+                                long delete_after);
+
+// add through the (wrapped) completion function, which needs 0 terminated strings
+static bool add_completion_item_copy(ic_completion_env_t* cenv, const ic_completion_item_t* item) {
+    alloc_t* mem = cenv->env->mem;
+    char* replacement = completion_strdup(cenv->env->completions, item->replacement,
+                                          item->replacement_len);
+    char* display = (item->display == NULL ? NULL
+                                           : completion_strdup(cenv->env->completions,
+                                                               item->display, item->display_len));
+    char* help = (item->help == NULL ? NULL
+                                     : completion_strdup(cenv->env->completions, item->help,
+                                                         item->help_len));
+    bool ok = false;
+    if (replacement != NULL && (display != NULL) == (item->display != NULL) &&
+        (help != NULL) == (item->help != NULL)) {
+        ok = ic_add_completion_ex(cenv, replacement, display, help);
+    }
+    mem_free(mem, replacement);
+    mem_free(mem, display);
+    mem_free(mem, help);
+    return ok;
+}
+
+ic_public bool ic_add_completions_n(ic_completion_env_t* cenv, const char* prefix,
+                                    const ic_completion_item_t* items, long count,
+                                    bool prefiltered) {
+    if (cenv == NULL || items == NULL || count <= 0)
+        return true;
+    ic_env_t* env = cenv->env;
+    // insert directly unless the completion function is wrapped (as by `ic_complete_word`)
+    const bool direct = (cenv->complete == &prim_add_completion);
+    const bool filter = (!prefiltered && prefix != NULL);
+    const ssize_t plen = (filter ? ic_strlen(prefix) : 0);
+    if (direct) {
+        const ssize_t remaining = completions_remaining(env->completions);
+        completions_reserve(env->completions, (count < remaining ? count : remaining));
+    }
+    for (long i = 0; i < count; i++) {
+        ic_completion_item_t item = items[i];
+        if (item.replacement == NULL)
+            continue;
+        if (item.replacement_len < 0) {
+            item.replacement_len = (long)ic_strlen(item.replacement);
+        }
+        if (filter && !completions_match_n(env, item.replacement, item.replacement_len, prefix,
+                                           plen)) {
+            continue;
+        }
+        const bool ok = (direct ? completions_add_item(env->completions, &item, NULL, 0, 0, 0)
+                                : add_completion_item_copy(cenv, &item));
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+ic_public bool ic_add_completion_borrowed(ic_completion_env_t* cenv, const char* replacement,
+                                          const char* display, const char* help) {
+    if (cenv == NULL || replacement == NULL)
+        return false;
+    completions_t* cms = cenv->env->completions;
+    cms->borrow_replacement = replacement;
+    cms->borrow_display = display;
+    cms->borrow_help = help;
+    const bool ok = ic_add_completion_ex(cenv, replacement, display, help);
+    cms->borrow_replacement = NULL;
+    cms->borrow_display = NULL;
+    cms->borrow_help = NULL;
+    return ok;
+}
+
+ic_public bool ic_add_completions_borrowed(ic_completion_env_t* cenv, const char* prefix,
+                                           const char** completions) {
+    for (const char** pc = completions; *pc != NULL; pc++) {
+        if (completions_match(cenv->env, *pc, prefix)) {
+            if (!ic_add_completion_borrowed(cenv, *pc, NULL, NULL))
+                return false;
+        }
+    }
+    return true;
+}
+
 ic_public bool ic_add_completion(ic_completion_env_t* cenv, const char* replacement) {
     return ic_add_completion_ex(cenv, replacement, NULL, NULL);
 }
@@ -489,11 +1069,952 @@ ic_public void ic_set_default_completer(ic_completer_fun_t* completer, void* arg
     completions_set_completer(env->completions, completer, arg);
 }
 
+ic_public bool ic_add_completion_provider(const char* name, ic_completer_fun_t* completer,
+                                          void* arg, int priority, long budget_ms) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    return completions_add_provider(env->completions, name, completer, arg, priority, budget_ms);
+}
+
+ic_public bool ic_remove_completion_provider(const char* name) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    return completions_remove_provider(env->completions, name);
+}
+
+ic_public bool ic_set_completer_monotonic(bool monotonic) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    return completions_set_monotonic(env->completions, monotonic);
+}
+
+ic_public bool ic_set_completer_isolated(bool isolated, long timeout_ms) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    return completions_set_isolated(env->completions, isolated, timeout_ms);
+}
+
+//-------------------------------------------------------------
+// Narrowing cache
+// For a prefix-monotonic completer, the completions for an extended word
+// are exactly the previous completions that still start with that word.
+// Instead of calling the completer again, we filter `elems` in place.
+//-------------------------------------------------------------
+
+// can the inserted text `s` (of length `len`) only extend the current word?
+static bool completions_is_word_extension(const char* s, ssize_t len) {
+    ssize_t i = 0;
+    while (i < len) {
+        ssize_t ofs = str_next_ofs(s, len, i, NULL);
+        if (ofs <= 0 || !ic_char_is_idletter(s + i, (long)ofs))
+            return false;
+        i += ofs;
+    }
+    return true;
+}
+
+// does a cached entry still match the extended word `word` (of length `len`)?
+static bool completion_still_matches(const completion_t* cm, const char* word, ssize_t len,
+                                     bool fuzzy) {
+    if (fuzzy) {
+        return fuzzy_is_match(word, len, cm->replacement, ic_strlen(cm->replacement));
+    }
+    return (ic_strnicmp(cm->replacement, word, len) == 0);
+}
+
+static bool completions_narrow(completions_t* cms, const char* input, ssize_t pos, ssize_t max,
+                               bool fuzzy, ssize_t* count) {
+    if (!cms->cache_valid || !cms->completer_monotonic || cms->cache_input == NULL)
+        return false;
+    if (cms->cache_completer != cms->completer || cms->cache_arg != cms->completer_arg)
+        return false;
+    const ssize_t cpos = cms->cache_pos;
+    if (pos < cpos || strncmp(input, cms->cache_input, to_size_t(cpos)) != 0)
+        return false;
+    if (strcmp(input + pos, cms->cache_input + cpos) != 0)
+        return false;  // the text after the cursor changed
+    if (!completions_is_word_extension(input + cpos, pos - cpos))
+        return false;
+    for (ssize_t i = 0; i < cms->count; i++) {
+        const completion_t* cm = cms->elems + i;
+        if (cm->delete_before > cpos || cm->delete_before < 0 || cm->delete_after != 0)
+            return false;
+        // an entry that does not match its word (like a recursive filename completion)
+        // cannot be narrowed
+        const ssize_t wstart = cpos - cm->delete_before;
+        if (!completion_still_matches(cm, input + wstart, cpos - wstart, fuzzy))
+            return false;
+    }
+    if (!cms->cache_complete) {
+        // only usable if at least `max` of the cached entries still match
+        ssize_t matches = 0;
+        for (ssize_t i = 0; i < cms->count && matches < max; i++) {
+            const completion_t* cm = cms->elems + i;
+            const ssize_t wstart = cpos - cm->delete_before;
+            if (completion_still_matches(cm, input + wstart, pos - wstart, fuzzy))
+                matches++;
+        }
+        if (matches < max)
+            return false;
+    }
+
+    // filter in place, preserving the completer order
+    ssize_t n = 0;
+    for (ssize_t i = 0; i < cms->count; i++) {
+        completion_t* cm = cms->elems + i;
+        const ssize_t wstart = cpos - cm->delete_before;
+        if (n < max && completion_still_matches(cm, input + wstart, pos - wstart, fuzzy)) {
+            cm->delete_before += (pos - cpos);
+            if (n != i) {
+                cms->elems[n] = *cm;
+                memset(cm, 0, sizeof(*cm));
+            }
+            n++;
+        } else {
+            if (n >= max)
+                cms->cache_complete = false;
+            completion_free_entry(cms, cm);
+        }
+    }
+    cms->count = n;
+    cms->sorted = 0;
+    cms->index_valid = false;
+
+    // and re-key the cache on the new input
+    char* new_input = mem_strdup(cms->mem, input);
+    if (new_input == NULL) {
+        completions_cache_invalidate(cms);
+    } else {
+        mem_free(cms->mem, cms->cache_input);
+        cms->cache_input = new_input;
+        cms->cache_pos = pos;
+    }
+    debug_msg("completion: narrowed to %zd entries at %zd\n", n, pos);
+    *count = n;
+    return true;
+}
+
+// check if each completion starts with the text it replaces, and score it (if `fuzzy`)
+static void completions_score(completions_t* cms, const char* input, ssize_t pos, bool fuzzy) {
+    if (fuzzy) {
+        cms->sorted = 0;
+    }
+    for (ssize_t i = 0; i < cms->count; i++) {
+        completion_t* cm = cms->elems + i;
+        const ssize_t len =
+            (cm->delete_before > pos || cm->delete_before < 0 ? 0 : cm->delete_before);
+        const char* word = input + pos - len;
+        const ssize_t rlen = ic_strlen(cm->replacement);
+        if (fuzzy) {
+            const long score = fuzzy_score(word, len, cm->replacement, rlen);
+            cm->score = (score < 0 ? 0 : score);
+        }
+        cm->prefix_match = (rlen >= len && ic_strnicmp(cm->replacement, word, len) == 0);
+    }
+}
+
+static void completions_cache_set(completions_t* cms, const char* input, ssize_t pos) {
+    completions_cache_invalidate(cms);
+    if (!cms->completer_monotonic || cms->provider_count > 0)
+        return;
+    cms->cache_input = mem_strdup(cms->mem, input);
+    if (cms->cache_input == NULL)
+        return;
+    cms->cache_valid = true;
+    cms->cache_complete = (cms->completer_max > 0 && !cms->partial);
+    cms->cache_completer = cms->completer;
+    cms->cache_arg = cms->completer_arg;
+    cms->cache_pos = pos;
+}
+
+//-------------------------------------------------------------
+// Completer helper process
+// With `ic_set_completer_isolated` the completer runs in a forked
+// helper process, so a completer that blocks in the kernel (on a
+// hung network mount, say) cannot hang the editor. The helper is
+// kept for later completions and is sent one request at a time;
+// it streams back a record per completion, followed by a record
+// that marks the end. Every record is a 32-bit length followed
+// by its payload (in native byte order). A request carries the
+// working directory of the editor, which the helper changes to
+// first. Completions are added as they arrive; if the time is up
+// first, the helper is killed and a fresh one is forked on the
+// next completion. A killed helper may not exit right away (in
+// an uninterruptible system call), so it is reaped later.
+//-------------------------------------------------------------
+
+#ifdef IC_COMPLETER_HELPER
+
+#define IC_HELPER_RECORD_MAX (16 * 1024 * 1024)  // larger records are a protocol error
+#define IC_HELPER_NULL (0xFFFFFFFFU)             // string length of a NULL string
+#define IC_HELPER_REQUEST_HEADER (3 * 8 + 4)     // cursor, maximum, budget, and cwd length
+#define IC_HELPER_TIMEOUT (1000)  // default time limit in milliseconds (if there is no budget)
+#define IC_HELPER_UNREAPED_MAX (16)
+
+#if defined(MSG_NOSIGNAL)
+#define IC_HELPER_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define IC_HELPER_SEND_FLAGS 0  // use SO_NOSIGPIPE instead
+#endif
+
+enum { HELPER_COMPLETION = 1, HELPER_DONE = 2 };
+
+typedef struct completer_helper_s {
+    pid_t pid;
+    int fd;                         // our end of the socket pair
+    ic_completer_fun_t* completer;  // the completer (and argument) the helper was forked with
+    void* arg;
+} completer_helper_t;
+
+// killed helpers that have not exited yet
+static pid_t helper_unreaped[IC_HELPER_UNREAPED_MAX];
+static ssize_t helper_unreaped_count;
+
+static bool helper_write(int fd, const void* buf, size_t len) {
+    const char* p = (const char*)buf;
+    while (len > 0) {
+        const ssize_t n = send(fd, p, len, IC_HELPER_SEND_FLAGS);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// read exactly `len` bytes before the `deadline` (or 0 to wait indefinitely)
+static bool helper_read(int fd, void* buf, size_t len, long long deadline) {
+    char* p = (char*)buf;
+    while (len > 0) {
+        if (deadline > 0) {
+            const long long wait = deadline - ic_clock_ms();
+            if (wait <= 0)
+                return false;
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            const int res = poll(&pfd, 1, (wait > 60000 ? 60000 : (int)wait));
+            if (res < 0 && errno == EINTR)
+                continue;
+            if (res < 0)
+                return false;
+            if (res == 0)
+                continue;  // check the deadline again
+        }
+        const ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static char* helper_put(char* p, const void* data, size_t len) {
+    memcpy(p, data, len);
+    return p + len;
+}
+
+static char* helper_put_str(char* p, const char* s) {
+    const uint32_t len = (s == NULL ? IC_HELPER_NULL : (uint32_t)strlen(s));
+    p = helper_put(p, &len, sizeof(len));
+    return (s == NULL ? p : helper_put(p, s, len));
+}
+
+static bool helper_get(const char** p, const char* end, void* data, size_t len) {
+    if ((size_t)(end - *p) < len)
+        return false;
+    memcpy(data, *p, len);
+    *p += len;
+    return true;
+}
+
+// send a completion to the editor (`funenv` points to the socket)
+static bool helper_add_completion_with_source(ic_env_t* env, void* funenv,
+                                              const char* replacement, const char* display,
+                                              const char* help, const char* source,
+                                              long delete_before, long delete_after) {
+    completions_t* cms = env->completions;
+    if (replacement == NULL || cms->completer_max <= 0 || completions_out_of_time(cms))
+        return false;
+    const char* strs[4] = {replacement, display, help, source};
+    const uint8_t kind = HELPER_COMPLETION;
+    const uint8_t plain = (cms->style_display != NULL && display == cms->style_display);
+    const uint64_t attr = (plain ? cms->style_attr.value : 0);
+    const int64_t deletes[2] = {delete_before, delete_after};
+    size_t len = sizeof(kind) + sizeof(plain) + sizeof(attr) + sizeof(deletes);
+    for (int i = 0; i < 4; i++) {
+        len += sizeof(uint32_t) + (strs[i] == NULL ? 0 : strlen(strs[i]));
+    }
+    if (len > IC_HELPER_RECORD_MAX)
+        return false;
+    char* rec = mem_malloc_tp_n(cms->mem, char, sizeof(uint32_t) + len);
+    if (rec == NULL)
+        return false;
+    const uint32_t rec_len = (uint32_t)len;
+    char* p = helper_put(rec, &rec_len, sizeof(rec_len));
+    p = helper_put(p, &kind, sizeof(kind));
+    p = helper_put(p, &plain, sizeof(plain));
+    p = helper_put(p, &attr, sizeof(attr));
+    p = helper_put(p, deletes, sizeof(deletes));
+    for (int i = 0; i < 4; i++) {
+        p = helper_put_str(p, strs[i]);
+    }
+    const bool ok = helper_write(*((int*)funenv), rec, sizeof(uint32_t) + len);
+    mem_free(cms->mem, rec);
+    if (!ok)
+        _exit(1);  // the editor is gone
+    cms->completer_max--;
+    return true;
+}
+
+static bool helper_add_completion(ic_env_t* env, void* funenv, const char* replacement,
+                                  const char* display, const char* help, long delete_before,
+                                  long delete_after) {
+    return helper_add_completion_with_source(env, funenv, replacement, display, help, NULL,
+                                             delete_before, delete_after);
+}
+
+// the main loop of the helper process: serve requests until the editor closes the socket
+static void completer_helper_main(ic_env_t* env, completions_t* cms, int fd) {
+    // the helper shares the terminal of the editor but must only ever be killed by the editor
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    completions_set_interrupt(cms, NULL, NULL);  // never read the terminal of the editor
+    while (true) {
+        uint32_t len;
+        if (!helper_read(fd, &len, sizeof(len), 0) || len < IC_HELPER_REQUEST_HEADER ||
+            len > IC_HELPER_RECORD_MAX)
+            break;
+        char* req = mem_malloc_tp_n(cms->mem, char, len + 1);
+        if (req == NULL || !helper_read(fd, req, len, 0))
+            break;
+        req[len] = 0;
+        int64_t header[3];  // cursor, maximum, and budget
+        uint32_t cwd_len;
+        memcpy(header, req, sizeof(header));
+        memcpy(&cwd_len, req + sizeof(header), sizeof(cwd_len));
+        if (cwd_len > len - IC_HELPER_REQUEST_HEADER)
+            break;
+        char* cwd = req + IC_HELPER_REQUEST_HEADER;
+        char* input = cwd + cwd_len;
+        const ssize_t input_len = (ssize_t)(len - IC_HELPER_REQUEST_HEADER - cwd_len);
+        if (cwd_len > 0) {
+            const char c = input[0];
+            input[0] = 0;
+            if (chdir(cwd) != 0) {
+                debug_msg("completion: helper cannot change to %s\n", cwd);
+            }
+            input[0] = c;
+        }
+        const ssize_t pos = (header[0] < 0 || header[0] > input_len ? input_len : header[0]);
+        cms->completer_max = (ssize_t)header[1];
+        cms->deadline = (header[2] > 0 ? ic_clock_ms() + header[2] : 0);
+        cms->partial = false;
+
+        ic_completion_env_t cenv;
+        cenv.env = env;
+        cenv.input = input, cenv.cursor = (long)pos;
+        cenv.arg = cms->completer_arg;
+        cenv.complete = &helper_add_completion;
+        cenv.complete_with_source = &helper_add_completion_with_source;
+        cenv.closure = &fd;
+        char* prefix = mem_strndup(cms->mem, input, pos);
+        if (prefix != NULL && cms->completer != NULL) {
+            cms->completer(&cenv, prefix);
+        }
+        mem_free(cms->mem, prefix);
+        mem_free(cms->mem, req);
+
+        char done[sizeof(uint32_t) + 1];
+        const uint32_t done_len = 1;
+        const uint8_t kind = HELPER_DONE;
+        helper_put(helper_put(done, &done_len, sizeof(done_len)), &kind, sizeof(kind));
+        if (!helper_write(fd, done, sizeof(done)))
+            break;
+    }
+    _exit(0);  // never run the `atexit` handlers of the editor (which restore the terminal)
+}
+
+// reap the killed helpers that have exited by now (without blocking)
+static void completer_helper_reap(void) {
+    ssize_t n = 0;
+    for (ssize_t i = 0; i < helper_unreaped_count; i++) {
+        const pid_t pid = helper_unreaped[i];
+        if (waitpid(pid, NULL, WNOHANG) == 0)
+            helper_unreaped[n++] = pid;  // still running
+    }
+    helper_unreaped_count = n;
+}
+
+static void completer_helper_stop(completions_t* cms) {
+    completer_helper_t* helper = cms->helper;
+    if (helper != NULL) {
+        close(helper->fd);
+        kill(helper->pid, SIGKILL);  // it may be blocked in the completer
+        if (waitpid(helper->pid, NULL, WNOHANG) == 0 &&
+            helper_unreaped_count < IC_HELPER_UNREAPED_MAX) {
+            helper_unreaped[helper_unreaped_count++] = helper->pid;
+        }
+        debug_msg("completion: stopped helper process %d\n", (int)helper->pid);
+        mem_free(cms->mem, helper);
+        cms->helper = NULL;
+    }
+    completer_helper_reap();
+}
+
+// start a helper (unless one is running for the current completer)
+static completer_helper_t* completer_helper_start(ic_env_t* env, completions_t* cms) {
+    if (cms->helper != NULL && cms->helper->completer == cms->completer &&
+        cms->helper->arg == cms->completer_arg)
+        return cms->helper;
+    completer_helper_stop(cms);
+    completers_atfork();  // reset the locks of the shared completer state in the helper
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return NULL;
+    for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);  // not inherited by processes the completer runs
+#if defined(SO_NOSIGPIPE)
+        const int on = 1;
+        setsockopt(fds[i], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+    completer_helper_t* helper = mem_zalloc_tp(cms->mem, completer_helper_t);
+    const pid_t pid = (helper == NULL ? -1 : fork());
+    if (pid == 0) {
+        close(fds[0]);
+        completer_helper_main(env, cms, fds[1]);  // does not return
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        mem_free(cms->mem, helper);
+        return NULL;
+    }
+    helper->pid = pid;
+    helper->fd = fds[0];
+    helper->completer = cms->completer;
+    helper->arg = cms->completer_arg;
+    cms->helper = helper;
+    debug_msg("completion: started helper process %d\n", (int)pid);
+    return helper;
+}
+
+// add a completion record received from the helper;
+// returns 1 at the end of the completions, and -1 for an invalid record
+static int completer_helper_receive(completions_t* cms, char* rec, uint32_t len) {
+    const char* p = rec;
+    const char* end = rec + len;
+    uint8_t kind;
+    if (!helper_get(&p, end, &kind, sizeof(kind)))
+        return -1;
+    if (kind == HELPER_DONE)
+        return 1;
+    uint8_t plain;
+    attr_t attr;
+    int64_t deletes[2];
+    if (kind != HELPER_COMPLETION || !helper_get(&p, end, &plain, sizeof(plain)) ||
+        !helper_get(&p, end, &attr.value, sizeof(attr.value)) ||
+        !helper_get(&p, end, deletes, sizeof(deletes)))
+        return -1;
+    char* strs[4];
+    uint32_t lens[4];
+    for (int i = 0; i < 4; i++) {
+        if (!helper_get(&p, end, &lens[i], sizeof(lens[i])))
+            return -1;
+        strs[i] = NULL;
+        if (lens[i] != IC_HELPER_NULL) {
+            if ((size_t)(end - p) < lens[i])
+                return -1;
+            strs[i] = rec + (p - rec);
+            p += lens[i];
+        }
+    }
+    // terminate the strings in place (overwriting lengths that were read already)
+    for (int i = 0; i < 4; i++) {
+        if (strs[i] != NULL)
+            strs[i][lens[i]] = 0;
+    }
+    if (plain)
+        completions_set_style(cms, strs[1], attr);
+    completions_add(cms, strs[0], strs[1], strs[2], strs[3], (ssize_t)deletes[0],
+                    (ssize_t)deletes[1]);
+    if (plain)
+        completions_set_style(cms, NULL, attr_none());
+    return 0;
+}
+
+static bool completer_helper_request(completer_helper_t* helper, completions_t* cms,
+                                     const char* input, ssize_t pos) {
+    // the helper completes relative to our working directory (which may have changed)
+    char cwd[4096];
+    const uint32_t cwd_len = (getcwd(cwd, sizeof(cwd)) != NULL ? (uint32_t)strlen(cwd) : 0);
+    const size_t input_len = strlen(input);
+    const size_t len = IC_HELPER_REQUEST_HEADER + cwd_len + input_len;
+    if (len > IC_HELPER_RECORD_MAX)
+        return false;
+    char* req = mem_malloc_tp_n(cms->mem, char, sizeof(uint32_t) + len);
+    if (req == NULL)
+        return false;
+    long long budget = 0;
+    if (cms->deadline > 0) {
+        budget = cms->deadline - ic_clock_ms();
+        if (budget <= 0)
+            budget = 1;
+    }
+    const uint32_t req_len = (uint32_t)len;
+    const int64_t header[3] = {pos, cms->completer_max, budget};
+    char* p = helper_put(req, &req_len, sizeof(req_len));
+    p = helper_put(p, header, sizeof(header));
+    p = helper_put(p, &cwd_len, sizeof(cwd_len));
+    p = helper_put(p, cwd, cwd_len);
+    helper_put(p, input, input_len);
+    const bool ok = helper_write(helper->fd, req, sizeof(uint32_t) + len);
+    mem_free(cms->mem, req);
+    return ok;
+}
+
+// run the completer in the helper; returns `false` if no helper could be started
+static bool completer_helper_run(ic_env_t* env, completions_t* cms, const char* input,
+                                 ssize_t pos) {
+    completer_helper_t* helper = completer_helper_start(env, cms);
+    if (helper != NULL && !completer_helper_request(helper, cms, input, pos)) {
+        completer_helper_stop(cms);  // it died since the last completion: try a fresh one
+        helper = completer_helper_start(env, cms);
+        if (helper != NULL && !completer_helper_request(helper, cms, input, pos)) {
+            completer_helper_stop(cms);
+            helper = NULL;
+        }
+    }
+    if (helper == NULL)
+        return false;
+    // always wait with a deadline: a helper that hangs must never hang the editor
+    long long deadline = ic_clock_ms() + cms->isolated_timeout_ms;
+    if (cms->deadline > 0 && cms->deadline < deadline)
+        deadline = cms->deadline;
+    int res = 0;
+    while (res == 0) {
+        uint32_t len;
+        char* rec = NULL;
+        if (!helper_read(helper->fd, &len, sizeof(len), deadline) || len == 0 ||
+            len > IC_HELPER_RECORD_MAX ||
+            (rec = mem_malloc_tp_n(cms->mem, char, len + 1)) == NULL ||
+            !helper_read(helper->fd, rec, len, deadline)) {
+            mem_free(cms->mem, rec);
+            res = -1;
+            break;
+        }
+        res = completer_helper_receive(cms, rec, len);
+        mem_free(cms->mem, rec);
+    }
+    if (res < 0) {
+        // out of time, crashed, or garbled: keep what we have and start afresh next time
+        debug_msg("completion: helper process cut short after %zd entries\n", cms->count);
+        cms->partial = true;
+        completer_helper_stop(cms);
+    }
+    return true;
+}
+
+#else
+
+static void completer_helper_stop(completions_t* cms) {
+    ic_unused(cms);
+}
+
+static bool completer_helper_run(ic_env_t* env, completions_t* cms, const char* input,
+                                 ssize_t pos) {
+    ic_unused(env);
+    ic_unused(cms);
+    ic_unused(input);
+    ic_unused(pos);
+    return false;
+}
+
+#endif
+
+ic_private bool completions_set_isolated(completions_t* cms, bool isolated, long timeout_ms) {
+    const bool prev = cms->isolated;
+    completer_helper_stop(cms);  // a new helper takes a fresh snapshot of the process
+#ifdef IC_COMPLETER_HELPER
+    cms->isolated = isolated;
+    cms->isolated_timeout_ms = (timeout_ms > 0 ? timeout_ms : IC_HELPER_TIMEOUT);
+#else
+    ic_unused(isolated);
+    ic_unused(timeout_ms);
+#endif
+    return prev;
+}
+
+//-------------------------------------------------------------
+// Completion providers
+// Named completers that run concurrently (each in its own thread)
+// with the default completer. Every provider adds to its own
+// completions, which are merged afterwards with the usual
+// deduplication (the entry of the highest priority wins). A
+// provider that exceeds its time budget is cut short: the
+// completions it added so far are merged and it is abandoned
+// (it frees its state when it eventually returns).
+//-------------------------------------------------------------
+
+ic_private bool completions_add_provider(completions_t* cms, const char* name,
+                                         ic_completer_fun_t* completer, void* arg, int priority,
+                                         long budget_ms) {
+    if (name == NULL || completer == NULL)
+        return false;
+    completions_remove_provider(cms, name);
+    char* pname = mem_strdup(cms->mem, name);
+    if (pname == NULL)
+        return false;
+    completion_provider_t* providers = mem_realloc_tp(cms->mem, completion_provider_t,
+                                                      cms->providers, cms->provider_count + 1);
+    if (providers == NULL) {
+        mem_free(cms->mem, pname);
+        return false;
+    }
+    cms->providers = providers;
+    completion_provider_t* p = &cms->providers[cms->provider_count++];
+    p->name = pname;
+    p->completer = completer;
+    p->arg = arg;
+    p->priority = priority;
+    p->budget_ms = (budget_ms > 0 ? budget_ms : 0);
+    completions_cache_invalidate(cms);
+    return true;
+}
+
+ic_private bool completions_remove_provider(completions_t* cms, const char* name) {
+    for (ssize_t i = 0; name != NULL && i < cms->provider_count; i++) {
+        if (strcmp(cms->providers[i].name, name) == 0) {
+            mem_free(cms->mem, cms->providers[i].name);
+            cms->provider_count--;
+            ic_memmove(cms->providers + i, cms->providers + i + 1,
+                       (cms->provider_count - i) * ssizeof(completion_provider_t));
+            completions_cache_invalidate(cms);
+            return true;
+        }
+    }
+    return false;
+}
+
+// move the completions of `from` into `cms` with the given priority; `from` is left empty
+static void completions_merge(completions_t* cms, completions_t* from, int priority) {
+    for (ssize_t i = 0; i < from->count; i++) {
+        completion_t* cm = from->elems + i;
+        cm->priority = priority;
+        const ssize_t existing = completions_find(cms, cm->replacement, ic_strlen(cm->replacement));
+        if (existing >= 0) {
+            if (priority > cms->elems[existing].priority) {
+                completion_free_entry(cms, cms->elems + existing);
+                cms->elems[existing] = *cm;  // same replacement, so the index stays valid
+            } else {
+                completion_free_entry(from, cm);
+            }
+        } else if (cms->completer_max > 0 && completions_reserve(cms, 1)) {
+            cms->completer_max--;
+            cms->sorted = 0;
+            cms->elems[cms->count++] = *cm;
+            if (cms->index_valid) {
+                if (2 * cms->count > cms->index_len) {
+                    completions_index_rebuild(cms);
+                } else {
+                    completions_index_insert(cms, cms->count - 1);
+                }
+            }
+        } else {
+            completion_free_entry(from, cm);
+        }
+        memset(cm, 0, sizeof(*cm));
+    }
+    from->count = 0;
+    from->sorted = 0;
+    from->index_valid = false;
+}
+
+#if !defined(_WIN32) && !defined(IC_NO_THREADS)
+#define IC_PROVIDER_THREADS
+#include <pthread.h>
+#include <time.h>
+#endif
+
+typedef struct provider_job_s {
+    struct provider_pool_s* pool;
+    ic_env_t env;          // copy of the environment with `completions` set to `cms`
+    completions_t* cms;    // completions of this provider
+    ic_completer_fun_t* completer;
+    void* arg;
+    int priority;
+    long budget_ms;
+    const char* name;
+    bool done;
+    bool cut;              // merged before it was done; further completions are ignored
+} provider_job_t;
+
+typedef struct provider_pool_s {
+    alloc_t mem;  // copy of the allocator (abandoned providers may outlive the environment)
+#ifdef IC_PROVIDER_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+    int refcount;  // the completer and each running provider
+    long long start;
+    long long deadline;  // deadline of the whole generation (or 0 for none)
+    char* input;
+    char* prefix;
+    long cursor;
+    ssize_t count;
+    provider_job_t* jobs;
+} provider_pool_t;
+
+static void provider_lock(provider_pool_t* pool) {
+#ifdef IC_PROVIDER_THREADS
+    pthread_mutex_lock(&pool->lock);
+#else
+    ic_unused(pool);
+#endif
+}
+
+static void provider_unlock(provider_pool_t* pool) {
+#ifdef IC_PROVIDER_THREADS
+    pthread_mutex_unlock(&pool->lock);
+#else
+    ic_unused(pool);
+#endif
+}
+
+static void provider_pool_free(provider_pool_t* pool) {
+    alloc_t mem = pool->mem;
+    for (ssize_t i = 0; i < pool->count; i++) {
+        completions_free(pool->jobs[i].cms);
+    }
+    mem_free(&mem, pool->jobs);
+    mem_free(&mem, pool->input);
+    mem_free(&mem, pool->prefix);
+#ifdef IC_PROVIDER_THREADS
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+#endif
+    mem_free(&mem, pool);
+}
+
+static void provider_pool_release(provider_pool_t* pool) {
+    provider_lock(pool);
+    const bool last = (--pool->refcount == 0);
+    provider_unlock(pool);
+    if (last) {
+        provider_pool_free(pool);
+    }
+}
+
+static bool provider_add(ic_env_t* env, void* funenv, const char* replacement,
+                         const char* display, const char* help, const char* source,
+                         long delete_before, long delete_after) {
+    provider_job_t* job = (provider_job_t*)funenv;
+    provider_lock(job->pool);
+    const bool ok = (!job->cut && completions_add(env->completions, replacement, display, help,
+                                                  source, delete_before, delete_after));
+    provider_unlock(job->pool);
+    return ok;
+}
+
+static bool provider_add_completion(ic_env_t* env, void* funenv, const char* replacement,
+                                    const char* display, const char* help, long delete_before,
+                                    long delete_after) {
+    return provider_add(env, funenv, replacement, display, help, NULL, delete_before,
+                        delete_after);
+}
+
+static void provider_job_run(provider_job_t* job) {
+    provider_pool_t* pool = job->pool;
+    ic_completion_env_t cenv;
+    cenv.env = &job->env;
+    cenv.input = pool->input;
+    cenv.cursor = pool->cursor;
+    cenv.arg = job->arg;
+    cenv.complete = &provider_add_completion;
+    cenv.complete_with_source = &provider_add;
+    cenv.closure = job;
+    (*job->completer)(&cenv, pool->prefix);
+    provider_lock(pool);
+    job->done = true;
+#ifdef IC_PROVIDER_THREADS
+    pthread_cond_broadcast(&pool->cond);
+#endif
+    provider_unlock(pool);
+}
+
+#ifdef IC_PROVIDER_THREADS
+static void* provider_worker(void* arg) {
+    provider_job_t* job = (provider_job_t*)arg;
+    provider_pool_t* pool = job->pool;
+    provider_job_run(job);
+    provider_pool_release(pool);
+    return NULL;
+}
+
+// wait until every provider is done or out of its budget (or the generation out of time)
+static void provider_pool_wait(provider_pool_t* pool) {
+    while (true) {
+        const long long now = ic_clock_ms();
+        long long wake = -1;
+        bool running = false;
+        for (ssize_t i = 0; i < pool->count; i++) {
+            const provider_job_t* job = &pool->jobs[i];
+            if (job->done)
+                continue;
+            long long deadline = (job->budget_ms > 0 ? pool->start + job->budget_ms : 0);
+            if (pool->deadline > 0 && (deadline <= 0 || pool->deadline < deadline))
+                deadline = pool->deadline;
+            if (deadline <= 0) {
+                running = true;
+                continue;
+            }
+            if (now < deadline) {
+                running = true;
+                if (wake < 0 || deadline < wake)
+                    wake = deadline;
+            }
+        }
+        if (!running)
+            break;
+        if (wake < 0) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        } else {
+            ic_cond_timedwait(&pool->cond, &pool->lock, wake);
+        }
+    }
+}
+#endif
+
+static provider_pool_t* provider_pool_new(ic_env_t* env, completions_t* cms, const char* input,
+                                          ssize_t pos, const char* prefix, ssize_t max) {
+    provider_pool_t* pool = mem_zalloc_tp(cms->mem, provider_pool_t);
+    if (pool == NULL)
+        return NULL;
+    pool->mem = *cms->mem;
+    pool->refcount = 1;
+    pool->deadline = cms->deadline;
+    pool->cursor = (long)pos;
+    pool->input = mem_strdup(&pool->mem, input);
+    pool->prefix = mem_strdup(&pool->mem, prefix);
+    pool->jobs = mem_zalloc_tp_n(&pool->mem, provider_job_t, cms->provider_count);
+    bool ok = (pool->input != NULL && pool->prefix != NULL && pool->jobs != NULL);
+    for (ssize_t i = 0; ok && i < cms->provider_count; i++) {
+        const completion_provider_t* p = &cms->providers[i];
+        provider_job_t* job = &pool->jobs[i];
+        job->cms = completions_new(&pool->mem);
+        if (job->cms == NULL) {
+            ok = false;
+            break;
+        }
+        pool->count++;
+        job->cms->completer_max = max;
+        job->cms->deadline = cms->deadline;
+        job->pool = pool;
+        job->env = *env;
+        job->env.mem = &pool->mem;
+        job->env.completions = job->cms;
+        job->completer = p->completer;
+        job->arg = p->arg;
+        job->priority = p->priority;
+        job->budget_ms = p->budget_ms;
+        job->name = p->name;  // only used while the registry is unchanged
+    }
+#ifdef IC_PROVIDER_THREADS
+    if (ok && pthread_mutex_init(&pool->lock, NULL) != 0) {
+        ok = false;
+    } else if (ok) {
+        ic_cond_init(&pool->cond);
+    }
+#endif
+    if (!ok) {
+        for (ssize_t i = 0; i < pool->count; i++) {
+            completions_free(pool->jobs[i].cms);
+        }
+        mem_free(&pool->mem, pool->jobs);
+        mem_free(&pool->mem, pool->input);
+        mem_free(&pool->mem, pool->prefix);
+        mem_free(cms->mem, pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// start the providers (in their own thread when possible)
+static void providers_start(provider_pool_t* pool) {
+#ifdef IC_PROVIDER_THREADS
+    completers_prepare();  // initialize shared state before the providers use it
+    pool->start = ic_clock_ms();
+    for (ssize_t i = 0; i < pool->count; i++) {
+        provider_job_t* job = &pool->jobs[i];
+        pthread_t thread;
+        provider_lock(pool);
+        pool->refcount++;
+        provider_unlock(pool);
+        if (pthread_create(&thread, NULL, &provider_worker, job) == 0) {
+            pthread_detach(thread);
+            continue;
+        }
+        provider_lock(pool);
+        pool->refcount--;
+        provider_unlock(pool);
+        provider_job_run(job);  // no thread available
+    }
+#else
+    for (ssize_t i = 0; i < pool->count; i++) {
+        provider_job_run(&pool->jobs[i]);
+    }
+#endif
+}
+
+// wait for the providers (within their budget) and merge their completions into `cms`
+static void providers_finish(provider_pool_t* pool, completions_t* cms) {
+    provider_lock(pool);
+#ifdef IC_PROVIDER_THREADS
+    provider_pool_wait(pool);
+#endif
+    for (ssize_t i = 0; i < pool->count; i++) {
+        provider_job_t* job = &pool->jobs[i];
+        if (!job->done) {
+            debug_msg("completion: provider \"%s\" is out of its budget of %ldms\n", job->name,
+                      job->budget_ms);
+            job->cut = true;
+            cms->partial = true;
+        }
+        completions_merge(cms, job->cms, job->priority);
+    }
+    provider_unlock(pool);
+    provider_pool_release(pool);
+}
+
 ic_private ssize_t completions_generate(struct ic_env_s* env, completions_t* cms, const char* input,
-                                        ssize_t pos, ssize_t max) {
-    completions_clear(cms);
-    if (cms->completer == NULL || input == NULL || ic_strlen(input) < pos)
+                                        ssize_t pos, ssize_t max, long budget_ms) {
+    cms->partial = false;
+    cms->context = frecency_context(input, pos);
+    if ((cms->completer == NULL && cms->provider_count <= 0) || input == NULL ||
+        ic_strlen(input) < pos) {
+        completions_clear(cms);
         return 0;
+    }
+    ssize_t narrowed;
+    if (completions_narrow(cms, input, pos, max, env->fuzzy, &narrowed)) {
+        if (env->fuzzy)
+            completions_score(cms, input, pos, true);
+        return narrowed;
+    }
+    completions_clear(cms);
 
     // set up env
     ic_completion_env_t cenv;
@@ -511,9 +2032,28 @@ ic_private ssize_t completions_generate(struct ic_env_s* env, completions_t* cms
         prefix = "";
     }
     cms->completer_max = max;
+    cms->deadline = (budget_ms > 0 ? ic_clock_ms() + budget_ms : 0);
 
-    // and complete
-    cms->completer(&cenv, prefix);
+    // and complete (concurrently with the providers)
+#ifdef IC_COMPLETER_HELPER
+    if (cms->isolated && cms->completer != NULL)
+        completer_helper_start(env, cms);  // fork before the provider threads start
+#endif
+    provider_pool_t* pool =
+        (cms->provider_count > 0 ? provider_pool_new(env, cms, input, pos, prefix, max) : NULL);
+    if (pool != NULL) {
+        providers_start(pool);
+    }
+    if (cms->completer != NULL) {
+        if (!cms->isolated || !completer_helper_run(env, cms, input, pos))
+            cms->completer(&cenv, prefix);
+    }
+    if (pool != NULL) {
+        providers_finish(pool, cms);
+    }
+    cms->deadline = 0;
+    completions_cache_set(cms, input, pos);
+    completions_score(cms, input, pos, env->fuzzy);
 
     // restore
     if (prefix_alloc != NULL) {
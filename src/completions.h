@@ -9,17 +9,29 @@
 #ifndef IC_COMPLETIONS_H
 #define IC_COMPLETIONS_H
 
+#include "attr.h"
 #include "common.h"
 #include "stringbuf.h"
 
 //-------------------------------------------------------------
 // Completions
 //-------------------------------------------------------------
-#define IC_MAX_COMPLETIONS_TO_SHOW (1000)
-#define IC_MAX_COMPLETIONS_TO_TRY (IC_MAX_COMPLETIONS_TO_SHOW / 4)
+#define IC_MAX_COMPLETIONS_TO_TRY (250)         // generated before showing the menu
+#define IC_MAX_COMPLETIONS_TO_SHOW (INTPTR_MAX)  // no limit in the expanded menu
 
 typedef struct completions_s completions_t;
 
+// The rendered menu cell of a completion; computed at most once per entry by the
+// completion menu (see `editline_completion.c`) and released with the entry.
+typedef struct completion_cell_s {
+    bool measured;      // is `width` valid?
+    ssize_t width;      // column width of the display, source, and help
+    ssize_t colwidth;   // column width `text` was rendered for
+    ssize_t emph_len;   // byte length of the display part in `text` (emphasized if selected)
+    stringbuf_t* text;  // rendered cell (or NULL)
+    attrbuf_t* attrs;   // attributes of `text`
+} completion_cell_t;
+
 ic_private completions_t* completions_new(alloc_t* mem);
 ic_private void completions_free(completions_t* cms);
 ic_private void completions_clear(completions_t* cms);
@@ -27,18 +39,43 @@ ic_private bool completions_add(completions_t* cms, const char* replacement, con
                                 const char* help, const char* source, ssize_t delete_before,
                                 ssize_t delete_after);
 ic_private ssize_t completions_count(completions_t* cms);
+ic_private ssize_t completions_remaining(completions_t* cms);
+ic_private bool completions_is_partial(completions_t* cms);
+// stop generating once `interrupt(arg)` returns `true` (polled while a deadline is set)
+ic_private void completions_set_interrupt(completions_t* cms, bool (*interrupt)(void* arg),
+                                          void* arg);
 ic_private ssize_t completions_generate(struct ic_env_s* env, completions_t* cms, const char* input,
-                                        ssize_t pos, ssize_t max);
+                                        ssize_t pos, ssize_t max, long budget_ms);
 ic_private void completions_sort(completions_t* cms);
+ic_private void completions_sort_top(completions_t* cms, ssize_t k);
+ic_private bool completions_has_ranks(completions_t* cms);
+ic_private void completions_rank_first(completions_t* cms);
+ic_private void completions_accept(completions_t* cms, ssize_t index);
+ic_private void completions_set_rank_file(completions_t* cms, const char* fname);
 ic_private void completions_set_completer(completions_t* cms, ic_completer_fun_t* completer,
                                           void* arg);
 ic_private const char* completions_get_display(completions_t* cms, ssize_t index,
                                                const char** help);
 ic_private const char* completions_get_replacement(completions_t* cms, ssize_t index);
 ic_private const char* completions_get_source(completions_t* cms, ssize_t index);
+ic_private completion_cell_t* completions_get_cell(completions_t* cms, ssize_t index);
+ic_private void completions_set_style(completions_t* cms, const char* display, attr_t attr);
+ic_private bool completions_get_style(completions_t* cms, ssize_t index, attr_t* attr);
 ic_private const char* completions_get_hint(completions_t* cms, ssize_t index, const char** help);
 ic_private void completions_get_completer(completions_t* cms, ic_completer_fun_t** completer,
                                           void** arg);
+ic_private bool completions_add_provider(completions_t* cms, const char* name,
+                                         ic_completer_fun_t* completer, void* arg, int priority,
+                                         long budget_ms);
+ic_private bool completions_remove_provider(completions_t* cms, const char* name);
+ic_private bool completions_set_monotonic(completions_t* cms, bool monotonic);
+ic_private bool completions_is_monotonic(completions_t* cms);
+ic_private bool completions_set_isolated(completions_t* cms, bool isolated, long timeout_ms);
+ic_private bool completions_match(struct ic_env_s* env, const char* candidate, const char* prefix);
+ic_private void dircache_free(void);
+ic_private void completers_prepare(void);
+ic_private void completers_atfork(void);
+ic_private void cmd_index_free(void);
 
 ic_private ssize_t completions_apply(completions_t* cms, ssize_t index, stringbuf_t* sbuf,
                                      ssize_t pos);
@@ -17,6 +17,7 @@
 #include "highlight.h"
 #include "history.h"
 #include "isocline.h"
+#include "spell.h"
 #include "stringbuf.h"
 #include "term.h"
 #include "tty.h"
@@ -26,12 +27,26 @@
 // The editor state
 //-------------------------------------------------------------
 
+// memoized hint for an input and cursor position
+#define IC_HINT_MEMO (8)
+#define IC_HINT_RANKED_MAX (64)  // candidates considered for a hint once completions are ranked
+#define IC_PREFETCH_BUDGET (100)  // time budget in milliseconds to prefetch completions
+
+typedef struct hint_memo_s {
+    char* input;  // NULL if unused
+    ssize_t pos;
+    char* hint;
+    char* help;
+} hint_memo_t;
+
 // editor state
 typedef struct editor_s {
     stringbuf_t* input;      // current user input
     stringbuf_t* extra;      // extra displayed info (for completion menu etc)
     stringbuf_t* hint;       // hint displayed as part of the input
     stringbuf_t* hint_help;  // help for a hint.
+    bool hint_pending;       // compute a hint (and prefetch completions) once the input is idle?
+    bool prefetched;         // do the completions hold a prefetch for the current input?
     ssize_t pos;             // current cursor position in the input
     ssize_t cur_rows;        // current used rows to display our content (including
                              // extra content)
@@ -52,6 +67,10 @@ typedef struct editor_s {
     // caches
     attrbuf_t* attrs;  // reuse attribute buffers
     attrbuf_t* attrs_extra;
+    stringbuf_t* extra_cells;  // pre-rendered extra info displayed after `extra` (or NULL)
+    attrbuf_t* attrs_cells;    // attributes of `extra_cells`
+    hint_memo_t hint_memo[IC_HINT_MEMO];  // recently computed hints (round robin)
+    ssize_t hint_memo_next;
 } editor_t;
 
 static void edit_generate_completions(ic_env_t* env, editor_t* eb, bool autotab);
@@ -214,9 +233,11 @@ static char* edit_line_inline(ic_env_t* env, const char* prompt_text,
 static void edit_refresh(ic_env_t* env, editor_t* eb);
 
 ic_private char* ic_editline(ic_env_t* env, const char* prompt_text) {
+    completions_clear(env->completions);  // do not narrow results from a previous line
     tty_start_raw(env->tty);
     term_start_raw(env->term);
     char* line = edit_line(env, prompt_text);
+    completions_clear(env->completions);  // release borrowed completion strings
     term_end_raw(env->term, false);
     tty_end_raw(env->tty);
     term_writeln(env->term, "");
@@ -226,9 +247,11 @@ ic_private char* ic_editline(ic_env_t* env, const char* prompt_text) {
 
 ic_private char* ic_editline_inline(ic_env_t* env, const char* prompt_text,
                                     const char* inline_right_text) {
+    completions_clear(env->completions);  // do not narrow results from a previous line
     tty_start_raw(env->tty);
     term_start_raw(env->term);
     char* line = edit_line_inline(env, prompt_text, inline_right_text);
+    completions_clear(env->completions);  // release borrowed completion strings
     term_end_raw(env->term, false);
     tty_end_raw(env->tty);
     term_writeln(env->term, "");
@@ -353,7 +376,7 @@ static bool edit_pos_is_at_row_end(ic_env_t* env, editor_t* eb) {
     return rc.last_on_row;
 }
 
-static bool edit_complete(ic_env_t* env, editor_t* eb, ssize_t idx);
+static bool edit_complete_apply(ic_env_t* env, editor_t* eb, ssize_t idx);
 
 static ssize_t edit_find_word_start(const char* input, ssize_t pos) {
     ssize_t start = pos;
@@ -368,72 +391,6 @@ static ssize_t edit_find_word_start(const char* input, ssize_t pos) {
     return start;
 }
 
-static inline char ascii_tolower_char(char c) {
-    if (c >= 'A' && c <= 'Z')
-        return (char)(c + ('a' - 'A'));
-    return c;
-}
-
-static size_t levenshtein_casefold(alloc_t* mem, const char* left, const char* right) {
-    if (left == NULL || right == NULL)
-        return SIZE_MAX;
-    size_t len_left = strlen(left);
-    size_t len_right = strlen(right);
-    if (len_left == 0)
-        return len_right;
-    if (len_right == 0)
-        return len_left;
-
-    size_t* prev = mem_malloc_tp_n(mem, size_t, len_right + 1);
-    size_t* curr = mem_malloc_tp_n(mem, size_t, len_right + 1);
-    if (prev == NULL || curr == NULL) {
-        mem_free(mem, prev);
-        mem_free(mem, curr);
-        return SIZE_MAX;
-    }
-
-    for (size_t j = 0; j <= len_right; ++j) {
-        prev[j] = j;
-    }
-
-    for (size_t i = 1; i <= len_left; ++i) {
-        curr[0] = i;
-        char cl = ascii_tolower_char(left[i - 1]);
-        for (size_t j = 1; j <= len_right; ++j) {
-            char cr = ascii_tolower_char(right[j - 1]);
-            size_t cost = (cl == cr ? 0 : 1);
-            size_t deletion = prev[j] + 1;
-            size_t insertion = curr[j - 1] + 1;
-            size_t substitution = prev[j - 1] + cost;
-            size_t best = deletion;
-            if (insertion < best)
-                best = insertion;
-            if (substitution < best)
-                best = substitution;
-            curr[j] = best;
-        }
-        size_t* tmp = prev;
-        prev = curr;
-        curr = tmp;
-    }
-
-    size_t result = prev[len_right];
-    mem_free(mem, prev);
-    mem_free(mem, curr);
-    return result;
-}
-
-static size_t edit_spell_threshold(size_t left_len, size_t right_len) {
-    size_t max_len = (left_len > right_len ? left_len : right_len);
-    if (max_len <= 2)
-        return 1;
-    if (max_len <= 4)
-        return 1;
-    if (max_len <= 6)
-        return 2;
-    return max_len / 2;
-}
-
 static bool edit_try_spell_correct(ic_env_t* env, editor_t* eb) {
     if (!env->spell_correct)
         return false;
@@ -464,28 +421,45 @@ static bool edit_try_spell_correct(ic_env_t* env, editor_t* eb) {
     sbuf_delete_from_to(eb->input, word_start, pos);
     eb->pos = word_start;
 
-    ssize_t candidate_count = completions_generate(env, env->completions, sbuf_string(eb->input),
-                                                   eb->pos, IC_MAX_COMPLETIONS_TO_TRY);
-    if (candidate_count <= 0) {
-        editor_undo_restore(eb, false);
-        completions_clear(env->completions);
-        mem_free(env->mem, original_word);
-        return false;
-    }
-
     ssize_t best_index = -1;
-    size_t best_distance = SIZE_MAX;
+    ssize_t best_distance = INTPTR_MAX;
     long best_length_diff = LONG_MAX;
     ssize_t original_len = ic_strlen(original_word);
 
+    // the closest word of the registered dictionary bounds the completions that are tried
+    ssize_t dict_distance = INTPTR_MAX;
+    const char* correction =
+        spell_dict_nearest(env->spell_dict, original_word, word_len, &dict_distance);
+    if (correction != NULL) {
+        best_distance = dict_distance;
+        best_length_diff = labs((long)ic_strlen(correction) - (long)original_len);
+    }
+
+    // an exact (case-insensitive) dictionary match cannot be beaten: skip the completer
+    ssize_t candidate_count = 0;
+    if (correction == NULL || dict_distance > 0) {
+        candidate_count =
+            completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
+                                 IC_MAX_COMPLETIONS_TO_TRY, env->complete_budget);
+    }
+
+    // candidates further away than the best one so far, or than their threshold, are cut short
+    spell_matcher_t matcher;
+    if (candidate_count > 0 &&
+        !spell_matcher_init(&matcher, env->mem, original_word, original_len)) {
+        candidate_count = 0;
+    }
     for (ssize_t i = 0; i < candidate_count; ++i) {
         const char* replacement = completions_get_replacement(env->completions, i);
         if (replacement == NULL || *replacement == '\0')
             continue;
-        size_t distance = levenshtein_casefold(env->mem, original_word, replacement);
-        if (distance == SIZE_MAX)
-            continue;
         ssize_t replacement_len = ic_strlen(replacement);
+        ssize_t max = spell_threshold(original_len, replacement_len);
+        if (best_distance < max)
+            max = best_distance;
+        ssize_t distance = spell_distance(&matcher, replacement, replacement_len, max);
+        if (distance > max)
+            continue;
         long len_diff = labs((long)replacement_len - (long)original_len);
         if (distance < best_distance ||
             (distance == best_distance && len_diff < best_length_diff)) {
@@ -494,16 +468,19 @@ static bool edit_try_spell_correct(ic_env_t* env, editor_t* eb) {
             best_index = i;
         }
     }
+    if (candidate_count > 0) {
+        spell_matcher_done(&matcher);
+    }
 
     bool applied = false;
     if (best_index >= 0) {
-        const char* best_replacement = completions_get_replacement(env->completions, best_index);
-        size_t replacement_len =
-            (best_replacement == NULL ? 0 : (size_t)ic_strlen(best_replacement));
-        size_t threshold = edit_spell_threshold((size_t)original_len, replacement_len);
-        if (best_distance <= threshold) {
-            applied = edit_complete(env, eb, best_index);
-        }
+        // a completion (like a file or an argument) is closer than the dictionary word
+        applied = edit_complete_apply(env, eb, best_index);  // not chosen by the user
+    } else if (correction != NULL && strcmp(correction, original_word) != 0) {
+        sbuf_insert_at(eb->input, correction, eb->pos);
+        eb->pos += ic_strlen(correction);
+        edit_refresh(env, eb);
+        applied = true;
     }
 
     if (!applied) {
@@ -708,6 +685,33 @@ static void edit_refresh_rows(ic_env_t* env, editor_t* eb, stringbuf_t* input, a
     sbuf_for_each_row(input, eb->termw, promptw, cpromptw, &edit_refresh_rows_iter, &info, NULL);
 }
 
+// append `len` bytes of pre-rendered text `s` with attributes `attrs` (which can be NULL)
+static void edit_append_rendered(stringbuf_t* sb, attrbuf_t* ab, const char* s,
+                                 const attr_t* attrs, ssize_t len) {
+    if (ab == NULL || attrs == NULL) {
+        sbuf_append_n(sb, s, len);
+        return;
+    }
+    ssize_t i = 0;
+    while (i < len) {
+        ssize_t n = 1;
+        while (i + n < len && attr_is_eq(attrs[i + n], attrs[i])) {
+            n++;
+        }
+        attrbuf_append_n(sb, ab, s + i, n, attrs[i]);
+        i += n;
+    }
+}
+
+static void edit_append_extra_cells(editor_t* eb, stringbuf_t* out, attrbuf_t* attr_out) {
+    const ssize_t len = sbuf_len(eb->extra_cells);
+    if (len <= 0)
+        return;
+    const attr_t* attrs =
+        (attrbuf_len(eb->attrs_cells) >= len ? attrbuf_attrs(eb->attrs_cells, len) : NULL);
+    edit_append_rendered(out, attr_out, sbuf_string(eb->extra_cells), attrs, len);
+}
+
 static void edit_refresh(ic_env_t* env, editor_t* eb) {
     // calculate the new cursor row and total rows needed
     ssize_t promptw, cpromptw;
@@ -736,13 +740,14 @@ static void edit_refresh(ic_env_t* env, editor_t* eb) {
 
     // render extra (like a completion menu)
     stringbuf_t* extra = NULL;
-    if (sbuf_len(eb->extra) > 0) {
+    if (sbuf_len(eb->extra) > 0 || sbuf_len(eb->extra_cells) > 0) {
         extra = sbuf_new(eb->mem);
         if (extra != NULL) {
             if (sbuf_len(eb->hint_help) > 0) {
                 bbcode_append(env->bbcode, sbuf_string(eb->hint_help), extra, eb->attrs_extra);
             }
             bbcode_append(env->bbcode, sbuf_string(eb->extra), extra, eb->attrs_extra);
+            edit_append_extra_cells(eb, extra, eb->attrs_extra);
         }
     }
 
@@ -948,13 +953,14 @@ static bool edit_resize(ic_env_t* env, editor_t* eb) {
 
     // render extra (like a completion menu)
     stringbuf_t* extra = NULL;
-    if (sbuf_len(eb->extra) > 0) {
+    if (sbuf_len(eb->extra) > 0 || sbuf_len(eb->extra_cells) > 0) {
         extra = sbuf_new(eb->mem);
         if (extra != NULL) {
             if (sbuf_len(eb->hint_help) > 0) {
                 bbcode_append(env->bbcode, sbuf_string(eb->hint_help), extra, NULL);
             }
             bbcode_append(env->bbcode, sbuf_string(eb->extra), extra, NULL);
+            edit_append_extra_cells(eb, extra, NULL);
         }
     }
     rowcol_t rc = {0};
@@ -995,17 +1001,60 @@ static void editor_append_hint_help(editor_t* eb, const char* help) {
     }
 }
 
-// refresh with possible hint
-static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
-    if (env->no_hint || env->hint_delay > 0) {
-        // refresh without hint first
-        edit_refresh(env, eb);
-        if (env->no_hint)
-            return;
+static void editor_hint_memo_clear(editor_t* eb) {
+    for (ssize_t i = 0; i < IC_HINT_MEMO; i++) {
+        hint_memo_t* memo = &eb->hint_memo[i];
+        mem_free(eb->mem, memo->input);
+        mem_free(eb->mem, memo->hint);
+        mem_free(eb->mem, memo->help);
+        memset(memo, 0, sizeof(*memo));
+    }
+    eb->hint_memo_next = 0;
+}
+
+static bool editor_hint_memo_lookup(editor_t* eb) {
+    const char* input = sbuf_string(eb->input);
+    for (ssize_t i = 0; i < IC_HINT_MEMO; i++) {
+        const hint_memo_t* memo = &eb->hint_memo[i];
+        if (memo->input != NULL && memo->pos == eb->pos && strcmp(memo->input, input) == 0) {
+            sbuf_replace(eb->hint, memo->hint);
+            sbuf_replace(eb->hint_help, memo->help);
+            return true;
+        }
     }
+    return false;
+}
+
+static void editor_hint_memo_add(editor_t* eb) {
+    hint_memo_t* memo = &eb->hint_memo[eb->hint_memo_next];
+    eb->hint_memo_next = (eb->hint_memo_next + 1) % IC_HINT_MEMO;
+    mem_free(eb->mem, memo->input);
+    mem_free(eb->mem, memo->hint);
+    mem_free(eb->mem, memo->help);
+    memo->input = mem_strdup(eb->mem, sbuf_string(eb->input));
+    memo->pos = eb->pos;
+    memo->hint = mem_strdup(eb->mem, sbuf_string(eb->hint));
+    memo->help = mem_strdup(eb->mem, sbuf_string(eb->hint_help));
+    if (memo->input == NULL || memo->hint == NULL || memo->help == NULL) {
+        mem_free(eb->mem, memo->input);
+        mem_free(eb->mem, memo->hint);
+        mem_free(eb->mem, memo->help);
+        memset(memo, 0, sizeof(*memo));
+    }
+}
 
-    // and see if we can construct a hint (displayed after a delay)
-    ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos, 2);
+// compute the hint for the current input and cursor position
+static void edit_compute_hint(ic_env_t* env, editor_t* eb) {
+    sbuf_clear(eb->hint);
+    sbuf_clear(eb->hint_help);
+    if (editor_hint_memo_lookup(eb))
+        return;
+    // once completions are ranked, the hint is the best ranked of more candidates
+    const ssize_t max = (completions_has_ranks(env->completions) ? IC_HINT_RANKED_MAX : 2);
+    ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
+                                         max, env->hint_budget);
+    const bool partial = completions_is_partial(env->completions);
+    completions_rank_first(env->completions);
     if (count >= 1) {
         const char* help = NULL;
         const char* hint = completions_get_hint(env->completions, 0, &help);
@@ -1024,8 +1073,8 @@ static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
                         if (newpos <= pos)
                             break;
                         pos = newpos;
-                        count =
-                            completions_generate(env, env->completions, sbuf_string(sb), pos, 2);
+                        count = completions_generate(env, env->completions, sbuf_string(sb),
+                                                     pos, 2, env->hint_budget);
                         if (count == 1) {
                             const char* extra_help = NULL;
                             extra_hint = completions_get_hint(env->completions, 0, &extra_help);
@@ -1040,11 +1089,59 @@ static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
             }
         }
     }
+    if (!partial) {
+        editor_hint_memo_add(eb);  // a partial hint is computed again
+    }
+}
 
-    if (env->hint_delay <= 0) {
-        // refresh with hint directly
-        edit_refresh(env, eb);
+// refresh and compute a hint once the input is idle (see `edit_read_key`)
+static void edit_refresh_hint(ic_env_t* env, editor_t* eb) {
+    edit_refresh(env, eb);
+    eb->hint_pending = (!env->no_hint || env->prefetch);
+}
+
+static bool edit_key_pending(void* arg) {
+    return tty_has_input((tty_t*)arg);
+}
+
+// Generate the completions on tab for the current input in advance; they are used by
+// `edit_generate_completions` if the next key is a tab. The prefetch stops as soon as a
+// key is pressed or its (short) time budget runs out; a partial result is not kept.
+static void edit_prefetch_completions(ic_env_t* env, editor_t* eb) {
+    long budget = IC_PREFETCH_BUDGET;
+    if (env->complete_budget > 0 && env->complete_budget < budget)
+        budget = env->complete_budget;
+    completions_set_interrupt(env->completions, &edit_key_pending, env->tty);
+    completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
+                         IC_MAX_COMPLETIONS_TO_TRY, budget);
+    completions_set_interrupt(env->completions, NULL, NULL);
+    eb->prefetched = !completions_is_partial(env->completions);
+    debug_msg("edit: prefetched %zd completions\n", completions_count(env->completions));
+}
+
+// Read a key. A pending hint is only computed (and displayed) once no key arrives within
+// the hint delay, so bursts of keys, like fast typing or a paste, never invoke the completer
+// for intermediate states. If the input stays idle, the completions are prefetched as well.
+static code_t edit_read_key(ic_env_t* env, editor_t* eb) {
+    eb->prefetched = false;  // any key discards the prefetch
+    if (!eb->hint_pending)
+        return tty_read(env->tty);
+    eb->hint_pending = false;
+    code_t c;
+    if (tty_read_timeout(env->tty, (env->hint_delay > 0 ? env->hint_delay : 0), &c))
+        return c;  // not idle: skip the hint
+    if (!env->no_hint) {
+        edit_compute_hint(env, eb);
+        if (sbuf_len(eb->hint) > 0) {
+            edit_refresh(env, eb);
+        }
+    }
+    if (env->prefetch && eb->pos >= 0) {
+        if (tty_read_timeout(env->tty, 0, &c))
+            return c;  // no longer idle
+        edit_prefetch_completions(env, eb);
     }
+    return tty_read(env->tty);
 }
 
 //-------------------------------------------------------------
@@ -1494,25 +1591,7 @@ static char* edit_line(ic_env_t* env, const char* prompt_text) {
     while (true) {
         // read a character
         term_flush(env->term);
-        if (env->hint_delay <= 0 || sbuf_len(eb.hint) == 0) {
-            // blocking read
-            c = tty_read(env->tty);
-        } else {
-            // timeout to display hint
-            if (!tty_read_timeout(env->tty, env->hint_delay, &c)) {
-                // timed-out
-                if (sbuf_len(eb.hint) > 0) {
-                    // display hint
-                    edit_refresh(env, &eb);
-                }
-                c = tty_read(env->tty);
-            } else {
-                // clear the pending hint if we got input before the delay
-                // expired
-                sbuf_clear(eb.hint);
-                sbuf_clear(eb.hint_help);
-            }
-        }
+        c = edit_read_key(env, &eb);
 
         // update terminal in case of a resize
         if (tty_term_resize_event(env->tty)) {
@@ -1755,6 +1834,7 @@ static char* edit_line(ic_env_t* env, const char* prompt_text) {
     sbuf_free(eb.extra);
     sbuf_free(eb.hint);
     sbuf_free(eb.hint_help);
+    editor_hint_memo_clear(&eb);
     mem_free(env->mem,
              (void*)eb.prompt_text);  // Free the allocated last line prompt
 
@@ -1836,25 +1916,7 @@ static char* edit_line_inline(ic_env_t* env, const char* prompt_text,
     while (true) {
         // read a character
         term_flush(env->term);
-        if (env->hint_delay <= 0 || sbuf_len(eb.hint) == 0) {
-            // blocking read
-            c = tty_read(env->tty);
-        } else {
-            // timeout to display hint
-            if (!tty_read_timeout(env->tty, env->hint_delay, &c)) {
-                // timed-out
-                if (sbuf_len(eb.hint) > 0) {
-                    // display hint
-                    edit_refresh(env, &eb);
-                }
-                c = tty_read(env->tty);
-            } else {
-                // clear the pending hint if we got input before the delay
-                // expired
-                sbuf_clear(eb.hint);
-                sbuf_clear(eb.hint_help);
-            }
-        }
+        c = edit_read_key(env, &eb);
 
         // update terminal in case of a resize
         if (tty_term_resize_event(env->tty)) {
@@ -2097,6 +2159,7 @@ static char* edit_line_inline(ic_env_t* env, const char* prompt_text,
     sbuf_free(eb.extra);
     sbuf_free(eb.hint);
     sbuf_free(eb.hint_help);
+    editor_hint_memo_clear(&eb);
     mem_free(env->mem,
              (void*)eb.prompt_text);  // Free the allocated last line prompt
 
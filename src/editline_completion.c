@@ -13,7 +13,7 @@ static bool edit_try_spell_correct(ic_env_t* env, editor_t* eb);
 //-------------------------------------------------------------
 
 // return true if anything changed
-static bool edit_complete(ic_env_t* env, editor_t* eb, ssize_t idx) {
+static bool edit_complete_apply(ic_env_t* env, editor_t* eb, ssize_t idx) {
     editor_start_modify(eb);
     ssize_t newpos = completions_apply(env->completions, idx, eb->input, eb->pos);
     if (newpos < 0) {
@@ -25,6 +25,14 @@ static bool edit_complete(ic_env_t* env, editor_t* eb, ssize_t idx) {
     return true;
 }
 
+// complete with the entry at `idx` and record its acceptance for ranking
+// (only used where the user chose the entry: in the menu or with a tab)
+static bool edit_complete(ic_env_t* env, editor_t* eb, ssize_t idx) {
+    completions_accept(env->completions, idx);
+    editor_hint_memo_clear(eb);  // hints may be ranked differently now
+    return edit_complete_apply(env, eb, idx);
+}
+
 static bool edit_complete_longest_prefix(ic_env_t* env, editor_t* eb) {
     editor_start_modify(eb);
     ssize_t newpos = completions_apply_longest_prefix(env->completions, eb->input, eb->pos);
@@ -43,44 +51,128 @@ ic_private void sbuf_append_tagged(stringbuf_t* sb, const char* tag, const char*
     sbuf_append(sb, "[/]");
 }
 
-static void editor_append_completion(ic_env_t* env, editor_t* eb, ssize_t idx, ssize_t width,
-                                     bool numbered, bool selected) {
+// Menu cells are measured and rendered at most once per completion (and column
+// width) and cached with the entry; redrawing the menu only copies the cells and
+// restyles the selected one.
+
+static ssize_t edit_completion_width(ic_env_t* env, ssize_t idx) {
+    completion_cell_t* cell = completions_get_cell(env->completions, idx);
+    if (cell == NULL)
+        return 0;
+    if (!cell->measured) {
+        const char* help = NULL;
+        const char* display = completions_get_display(env->completions, idx, &help);
+        const char* source = completions_get_source(env->completions, idx);
+        attr_t attr;
+        ssize_t w = (completions_get_style(env->completions, idx, &attr)
+                         ? str_column_width(display)
+                         : bbcode_column_width(env->bbcode, display));
+        if (source != NULL) {
+            w += 3 + bbcode_column_width(env->bbcode, source);  // space + ( + source + )
+        }
+        if (help != NULL) {
+            w += 2 + bbcode_column_width(env->bbcode, help);
+        }
+        cell->width = w;
+        cell->measured = true;
+    }
+    return cell->width;
+}
+
+static completion_cell_t* edit_completion_cell(ic_env_t* env, ssize_t idx, ssize_t width) {
+    completion_cell_t* cell = completions_get_cell(env->completions, idx);
+    if (cell == NULL)
+        return NULL;
+    if (cell->text != NULL && cell->colwidth == width)
+        return cell;
+    if (cell->text == NULL) {
+        cell->text = sbuf_new(env->mem);
+        cell->attrs = attrbuf_new(env->mem);
+        if (cell->text == NULL || cell->attrs == NULL) {
+            sbuf_free(cell->text);
+            attrbuf_free(cell->attrs);
+            cell->text = NULL;
+            cell->attrs = NULL;
+            return NULL;
+        }
+    }
+    stringbuf_t* markup = sbuf_new(env->mem);
+    if (markup == NULL)
+        return NULL;
     const char* help = NULL;
     const char* display = completions_get_display(env->completions, idx, &help);
     const char* source = completions_get_source(env->completions, idx);
-    if (display == NULL)
-        return;
-    if (numbered) {
-        sbuf_appendf(eb->extra, "[ic-info]%s%zd [/]",
-                     (selected ? (tty_is_utf8(env->tty) ? "\xE2\x86\x92" : "*") : " "), 1 + idx);
-        width -= 3;
+    attr_t attr;
+    const bool plain = completions_get_style(env->completions, idx, &attr);
+
+    // the display comes first; measure its rendered length for the selection emphasis
+    sbuf_clear(cell->text);
+    attrbuf_clear(cell->attrs);
+    if (plain) {
+        cell->emph_len = ic_strlen(display);
+    } else {
+        bbcode_append(env->bbcode, display, cell->text, NULL);
+        cell->emph_len = sbuf_len(cell->text);
     }
 
     if (width > 0) {
-        sbuf_appendf(eb->extra, "[width=\"%zd;left; ;on\"]", width);
+        sbuf_appendf(markup, "[width=\"%zd;left; ;on\"]", width);
     }
-    if (selected) {
-        sbuf_append(eb->extra, "[ic-emphasis]");
-    }
-    sbuf_append(eb->extra, display);
-    if (selected) {
-        sbuf_append(eb->extra, "[/ic-emphasis]");
+    if (plain) {
+        sbuf_append(markup, "[!pre]");
+        sbuf_append(markup, display);
+        sbuf_append(markup, "[/pre]");
+    } else {
+        sbuf_append(markup, display);
     }
-
-    // Add source information if available
     if (source != NULL) {
-        sbuf_append(eb->extra, " ");
-        sbuf_append_tagged(eb->extra, "ic-info", "(");
-        sbuf_append_tagged(eb->extra, "ic-info", source);
-        sbuf_append_tagged(eb->extra, "ic-info", ")");
+        sbuf_append(markup, " ");
+        sbuf_append_tagged(markup, "ic-info", "(");
+        sbuf_append_tagged(markup, "ic-info", source);
+        sbuf_append_tagged(markup, "ic-info", ")");
     }
-
     if (help != NULL) {
-        sbuf_append(eb->extra, "  ");
-        sbuf_append_tagged(eb->extra, "ic-info", help);
+        sbuf_append(markup, "  ");
+        sbuf_append_tagged(markup, "ic-info", help);
     }
     if (width > 0) {
-        sbuf_append(eb->extra, "[/width]");
+        sbuf_append(markup, "[/width]");
+    }
+    sbuf_clear(cell->text);
+    bbcode_append(env->bbcode, sbuf_string(markup), cell->text, cell->attrs);
+    sbuf_free(markup);
+    if (cell->emph_len > sbuf_len(cell->text)) {
+        cell->emph_len = sbuf_len(cell->text);
+    }
+    if (plain) {
+        attrbuf_update_at(cell->attrs, 0, cell->emph_len, attr);
+    }
+    cell->colwidth = width;
+    return cell;
+}
+
+static void editor_append_completion(ic_env_t* env, editor_t* eb, ssize_t idx, ssize_t width,
+                                     bool numbered, bool selected) {
+    if (idx < 0 || idx >= completions_count(env->completions))
+        return;
+    if (numbered) {
+        char num[32];
+        snprintf(num, sizeof(num), "%s%zd ",
+                 (selected ? (tty_is_utf8(env->tty) ? "\xE2\x86\x92" : "*") : " "), 1 + idx);
+        attrbuf_append_n(eb->extra_cells, eb->attrs_cells, num, ic_strlen(num),
+                         bbcode_style(env->bbcode, "ic-info"));
+        width -= 3;
+    }
+    completion_cell_t* cell = edit_completion_cell(env, idx, width);
+    if (cell == NULL)
+        return;
+    const ssize_t start = sbuf_len(eb->extra_cells);
+    const ssize_t len = sbuf_len(cell->text);
+    edit_append_rendered(eb->extra_cells, eb->attrs_cells, sbuf_string(cell->text),
+                         attrbuf_attrs(cell->attrs, len), len);
+    if (selected) {
+        attrbuf_update_at(eb->attrs_cells, start, cell->emph_len,
+                          bbcode_style(env->bbcode, "ic-emphasis"));
     }
 }
 
@@ -93,39 +185,24 @@ static void editor_append_completion(ic_env_t* env, editor_t* eb, ssize_t idx, s
 #define IC_DISPLAY3_COL (3 + IC_DISPLAY3_MAX)
 #define IC_DISPLAY3_WIDTH (3 * IC_DISPLAY3_COL + 2 * 2)  // 76
 
-static void editor_append_completion2(ic_env_t* env, editor_t* eb, ssize_t col_width, ssize_t idx1,
-                                      ssize_t idx2, ssize_t selected) {
-    editor_append_completion(env, eb, idx1, col_width, true, (idx1 == selected));
-    sbuf_append(eb->extra, "  ");
-    editor_append_completion(env, eb, idx2, col_width, true, (idx2 == selected));
-}
-
-static void editor_append_completion3(ic_env_t* env, editor_t* eb, ssize_t col_width, ssize_t idx1,
-                                      ssize_t idx2, ssize_t idx3, ssize_t selected) {
-    editor_append_completion(env, eb, idx1, col_width, true, (idx1 == selected));
-    sbuf_append(eb->extra, "  ");
-    editor_append_completion(env, eb, idx2, col_width, true, (idx2 == selected));
-    sbuf_append(eb->extra, "  ");
-    editor_append_completion(env, eb, idx3, col_width, true, (idx3 == selected));
+// append row `rw` of a menu with `columns` columns of `percolumn` entries each
+static void editor_append_completion_row(ic_env_t* env, editor_t* eb, ssize_t columns,
+                                         ssize_t col_width, ssize_t percolumn, ssize_t count,
+                                         ssize_t rw, ssize_t selected) {
+    for (ssize_t col = 0; col < columns; col++) {
+        const ssize_t idx = (col * percolumn) + rw;
+        if (idx >= count)
+            break;
+        if (col > 0)
+            attrbuf_append_n(eb->extra_cells, eb->attrs_cells, "  ", 2, attr_none());
+        editor_append_completion(env, eb, idx, col_width, true, (idx == selected));
+    }
 }
 
 static ssize_t edit_completions_max_width(ic_env_t* env, ssize_t count) {
     ssize_t max_width = 0;
     for (ssize_t i = 0; i < count; i++) {
-        const char* help = NULL;
-        const char* source = completions_get_source(env->completions, i);
-        ssize_t w =
-            bbcode_column_width(env->bbcode, completions_get_display(env->completions, i, &help));
-
-        // Add space for source information if available
-        if (source != NULL) {
-            w += 3 + bbcode_column_width(env->bbcode,
-                                         source);  // space + ( + source + )
-        }
-
-        if (help != NULL) {
-            w += 2 + bbcode_column_width(env->bbcode, help);
-        }
+        ssize_t w = edit_completion_width(env, i);
         if (w > max_width) {
             max_width = w;
         }
@@ -133,67 +210,113 @@ static ssize_t edit_completions_max_width(ic_env_t* env, ssize_t count) {
     return max_width;
 }
 
+// The menu shows up to 9 entries in 1, 2 or 3 columns. When expanded, all
+// entries are shown in a virtualized scrolling window: only the visible rows
+// are formatted on each redraw, keeping the selected row in view.
 static void edit_completion_menu(ic_env_t* env, editor_t* eb, bool more_available) {
     ssize_t count = completions_count(env->completions);
     ssize_t count_displayed = count;
     assert(count > 1);
     ssize_t selected = (env->complete_nopreview ? 0 : -1);  // select first or none
     ssize_t percolumn = count;
+    ssize_t columns = 1;
+    ssize_t colwidth = -1;
+    ssize_t visible_rows = count;
+    ssize_t top_row = 0;         // first visible row in expanded mode
     bool expanded_mode = false;  // track if user pressed Ctrl+J to expand
+    bool relayout = true;
+    stringbuf_t* status = sbuf_new(eb->mem);
+    eb->extra_cells = sbuf_new(eb->mem);
+    eb->attrs_cells = attrbuf_new(eb->mem);
 
 again:
-    // show completions (limit to 9 normally, but show more in expanded mode)
     sbuf_clear(eb->extra);
-    ssize_t twidth = term_get_width(env->term) - 1;
-    ssize_t colwidth;
-    ssize_t max_display = expanded_mode ? count : 9;  // show all in expanded mode
-    if (count > 3 &&
-        ((colwidth = 3 + edit_completions_max_width(env, max_display)) * 3 + 2 * 2) < twidth) {
-        // display as a 3 column block
-        count_displayed = (count > max_display ? max_display : count);
-        percolumn = (count_displayed + 2) / 3;  // calculate rows needed
-        for (ssize_t rw = 0; rw < percolumn; rw++) {
-            if (rw > 0)
-                sbuf_append(eb->extra, "\n");
-            editor_append_completion3(env, eb, colwidth, rw, percolumn + rw, (2 * percolumn) + rw,
-                                      selected);
+    sbuf_clear(eb->extra_cells);
+    attrbuf_clear(eb->attrs_cells);
+    sbuf_clear(status);
+    if (relayout) {
+        // determine the layout (limit to 9 normally, but show all in expanded mode)
+        relayout = false;
+        ssize_t twidth = term_get_width(env->term) - 1;
+        ssize_t max_display = expanded_mode ? count : 9;
+        if (count > 3 &&
+            ((colwidth = 3 + edit_completions_max_width(env, max_display)) * 3 + 2 * 2) < twidth) {
+            // display as a 3 column block
+            columns = 3;
+        } else if (count > 4 &&
+                   ((colwidth = 3 + edit_completions_max_width(env, max_display)) * 2 + 2) <
+                       twidth) {
+            // display as a 2 column block if some entries are too wide for three
+            // columns
+            columns = 2;
+            max_display = expanded_mode ? count : 8;
+        } else {
+            // display as a list
+            columns = 1;
+            colwidth = -1;
         }
-    } else if (count > 4 &&
-               ((colwidth = 3 + edit_completions_max_width(env, max_display)) * 2 + 2) < twidth) {
-        // display as a 2 column block if some entries are too wide for three
-        // columns
-        max_display = expanded_mode ? count : 8;
         count_displayed = (count > max_display ? max_display : count);
-        percolumn = (count_displayed + 1) / 2;  // calculate rows needed
-        for (ssize_t rw = 0; rw < percolumn; rw++) {
-            if (rw > 0)
-                sbuf_append(eb->extra, "\n");
-            editor_append_completion2(env, eb, colwidth, rw, percolumn + rw, selected);
+        percolumn = (count_displayed + columns - 1) / columns;  // calculate rows needed
+        visible_rows = percolumn;
+        if (expanded_mode) {
+            ssize_t avail = term_get_height(env->term) - 4;
+            if (avail < 3)
+                avail = 3;
+            if (visible_rows > avail)
+                visible_rows = avail;
         }
-    } else {
-        // display as a list
-        count_displayed = (count > max_display ? max_display : count);
-        percolumn = count_displayed;
-        for (ssize_t i = 0; i < count_displayed; i++) {
-            if (i > 0)
-                sbuf_append(eb->extra, "\n");
-            editor_append_completion(env, eb, i, -1, true /* numbered */, selected == i);
+    }
+    if (expanded_mode) {
+        // scroll such that the selected row is visible
+        if (selected >= 0) {
+            const ssize_t row = selected % percolumn;
+            if (row < top_row)
+                top_row = row;
+            else if (row >= top_row + visible_rows)
+                top_row = row - visible_rows + 1;
         }
+        if (top_row > percolumn - visible_rows)
+            top_row = percolumn - visible_rows;
+        if (top_row < 0)
+            top_row = 0;
+    } else {
+        top_row = 0;
+    }
+    for (ssize_t rw = top_row; rw < top_row + visible_rows; rw++) {
+        if (rw > top_row)
+            attrbuf_append_n(eb->extra_cells, eb->attrs_cells, "\n", 1, attr_none());
+        editor_append_completion_row(env, eb, columns, colwidth, percolumn, count_displayed, rw,
+                                     selected);
     }
     if (count > count_displayed) {
         if (more_available) {
-            sbuf_append(eb->extra,
+            sbuf_append(status,
                         "\n[ic-info](press page-down (or ctrl-j) to see all further "
                         "completions)[/]");
         } else {
-            sbuf_appendf(eb->extra,
+            sbuf_appendf(status,
                          "\n[ic-info](press page-down (or ctrl-j) to see all %zd "
                          "completions)[/]",
                          count);
         }
+    } else if (visible_rows < percolumn) {
+        sbuf_appendf(status,
+                     "\n[ic-info](rows %zd-%zd of %zd; page-up/page-down to scroll)[/]",
+                     top_row + 1, top_row + visible_rows, percolumn);
+    } else if (more_available && !expanded_mode) {
+        sbuf_append(status, "\n[ic-info](more results pending; press page-down (or ctrl-j) to "
+                            "complete again)[/]");
+    }
+    if (more_available && expanded_mode) {
+        // out of time again
+        sbuf_append(status, "\n[ic-info](more results pending; press page-down (or ctrl-j) on "
+                            "the last page to complete again)[/]");
+    }
+    if (sbuf_len(status) > 0) {
+        bbcode_append(env->bbcode, sbuf_string(status), eb->extra_cells, eb->attrs_cells);
     }
     if (!env->complete_nopreview && selected >= 0 && selected <= count_displayed) {
-        edit_complete(env, eb, selected);
+        edit_complete_apply(env, eb, selected);  // preview
         editor_undo_restore(eb, false);
     } else {
         edit_refresh(env, eb);
@@ -203,8 +326,10 @@ again:
     code_t c = tty_read(env->tty);
     if (tty_term_resize_event(env->tty)) {
         edit_resize(env, eb);
+        relayout = true;
     }
     sbuf_clear(eb->extra);
+    sbuf_clear(eb->extra_cells);
 
     // direct selection?
     if (c >= '1' && c <= '9') {
@@ -230,6 +355,21 @@ again:
             // term_beep(env->term);
         }
         goto again;
+    } else if (expanded_mode && (c == KEY_PAGEDOWN || c == KEY_LINEFEED) &&
+               !(more_available && top_row + visible_rows >= percolumn)) {
+        // scroll a page down (on the last page, complete again if more results are pending)
+        top_row += visible_rows;
+        selected = (selected < 0 ? 0 : selected + visible_rows);
+        if (selected >= count_displayed)
+            selected = count_displayed - 1;
+        goto again;
+    } else if (expanded_mode && c == KEY_PAGEUP) {
+        // scroll a page up
+        top_row -= visible_rows;
+        selected = (selected < 0 ? 0 : selected - visible_rows);
+        if (selected < 0)
+            selected = 0;
+        goto again;
     } else if (c == KEY_F1) {
         edit_show_help(env, eb);
         goto again;
@@ -251,17 +391,21 @@ again:
         // if in preview mode, select the current entry and exit the menu
         assert(selected < count);
         edit_complete(env, eb, selected);
-    } else if ((c == KEY_PAGEDOWN || c == KEY_LINEFEED) && count > 9) {
+    } else if ((c == KEY_PAGEDOWN || c == KEY_LINEFEED) && (count > 9 || more_available)) {
         // expand completion menu to show all completions (stay interactive)
         c = 0;
         if (more_available) {
-            // generate all entries (up to the max (= 1000))
+            // generate all entries
             count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
-                                         IC_MAX_COMPLETIONS_TO_SHOW);
-            more_available = false;  // we now have all available completions
+                                         IC_MAX_COMPLETIONS_TO_SHOW, env->complete_budget);
+            // we now have all available completions (unless cut short by the time budget)
+            more_available = completions_is_partial(env->completions);
         }
+        completions_sort(env->completions);  // only the first page was sorted so far
         // Enable expanded mode to show all completions
         expanded_mode = true;
+        relayout = true;
+        top_row = 0;
         // Reset selection to first item and redisplay the interactive menu
         selected = (env->complete_nopreview ? 0 : -1);
         goto again;
@@ -269,6 +413,11 @@ again:
         edit_refresh(env, eb);
     }
     // done
+    sbuf_free(status);
+    sbuf_free(eb->extra_cells);
+    attrbuf_free(eb->attrs_cells);
+    eb->extra_cells = NULL;
+    eb->attrs_cells = NULL;
     completions_clear(env->completions);
     if (c != 0)
         tty_code_pushback(env->tty, c);
@@ -278,9 +427,16 @@ static void edit_generate_completions(ic_env_t* env, editor_t* eb, bool autotab)
     debug_msg("edit: complete: %zd: %s\n", eb->pos, sbuf_string(eb->input));
     if (eb->pos < 0)
         return;
-    ssize_t count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
-                                         IC_MAX_COMPLETIONS_TO_TRY);
-    bool more_available = (count >= IC_MAX_COMPLETIONS_TO_TRY);
+    ssize_t count;
+    if (eb->prefetched) {
+        count = completions_count(env->completions);  // generated while the input was idle
+        eb->prefetched = false;
+    } else {
+        count = completions_generate(env, env->completions, sbuf_string(eb->input), eb->pos,
+                                     IC_MAX_COMPLETIONS_TO_TRY, env->complete_budget);
+    }
+    bool more_available =
+        (count >= IC_MAX_COMPLETIONS_TO_TRY || completions_is_partial(env->completions));
     if (count <= 0) {
         // no completions
         if (!autotab) {
@@ -289,8 +445,10 @@ static void edit_generate_completions(ic_env_t* env, editor_t* eb, bool autotab)
             }
         }
     } else if (count == 1) {
-        // complete if only one match
-        if (edit_complete(env, eb, 0 /*idx*/) && env->complete_autotab) {
+        // complete if only one match (only an explicit tab counts as accepting it)
+        const bool applied =
+            (autotab ? edit_complete_apply(env, eb, 0) : edit_complete(env, eb, 0 /*idx*/));
+        if (applied && env->complete_autotab) {
             tty_code_pushback(env->tty, KEY_EVENT_AUTOTAB);
         }
     } else {
@@ -298,7 +456,7 @@ static void edit_generate_completions(ic_env_t* env, editor_t* eb, bool autotab)
         if (!more_available) {
             edit_complete_longest_prefix(env, eb);
         }
-        completions_sort(env->completions);
+        completions_sort_top(env->completions, 9);  // the rest is sorted when expanded
         edit_completion_menu(env, eb, more_available);
     }
 }
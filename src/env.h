@@ -16,6 +16,7 @@
 #include "completions.h"
 #include "history.h"
 #include "isocline.h"
+#include "spell.h"
 #include "term.h"
 #include "tty.h"
 
@@ -31,6 +32,7 @@ struct ic_env_s {
     term_t* term;                        // terminal
     tty_t* tty;                          // keyboard (NULL if stdin is a pipe, file, etc)
     completions_t* completions;          // current completions
+    spell_dict_t* spell_dict;            // words for spell correction (or NULL)
     history_t* history;                  // edit history
     bbcode_t* bbcode;                    // print with bbcodes
     const char* prompt_marker;           // the prompt marker (defaults to "> ")
@@ -53,17 +55,26 @@ struct ic_env_s {
                                          // initial prompt
     bool no_help;                        // show short help line for history search etc.
     bool no_hint;                        // allow hinting?
+    bool prefetch;                       // prefetch the completions while the input is idle?
     bool no_highlight;                   // enable highlighting?
     bool no_bracematch;                  // enable brace matching?
     bool no_autobrace;                   // enable automatic brace insertion?
     bool no_lscolors;                    // use LSCOLORS/LS_COLORS to colorize file name
                                          // completions?
     bool spell_correct;                  // enable spell correction on completions?
+    bool fuzzy;                          // use fuzzy matching and ranking for completions?
+    bool no_dircache;                    // cache directory listings for filename completion?
     bool prompt_cleanup;                 // after enter, rewrite prompt inline?
     bool prompt_cleanup_add_empty_line;  // optionally add empty line after
                                          // cleanup
     size_t prompt_cleanup_extra_lines;   // additional terminal lines to erase during cleanup
     long hint_delay;                     // delay before displaying a hint in milliseconds
+    long hint_budget;                    // time budget in milliseconds to complete a hint (or 0)
+    long complete_budget;                // time budget in milliseconds to complete on tab (or 0)
+    long fname_threads;                  // threads to scan filename roots (<= 1 is sequential)
+    long fname_timeout;                  // timeout in milliseconds for each filename root
+    long glob_depth;                     // maximal depth of a recursive (`**`) filename walk
+    long glob_entries;                   // maximal entries visited by a recursive walk
 
     ic_key_binding_entry_t* key_bindings;  // dynamic array of custom key bindings
     ssize_t key_binding_count;
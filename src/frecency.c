@@ -0,0 +1,290 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#include "frecency.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "common.h"
+
+#define IC_FRECENCY_MAX (4096)   // maximal entries (the least recent half is dropped)
+#define IC_FRECENCY_EXT ".rank"  // extension of the file next to the history file
+#define IC_FRECENCY_FNV_OFFSET (14695981039346656037ULL)
+#define IC_FRECENCY_FNV_PRIME (1099511628211ULL)
+
+typedef struct frecency_entry_s {
+    uint64_t key;    // hash of the context and replacement (0 for an empty slot)
+    uint32_t count;  // times accepted
+    long long last;  // time of the last acceptance (in seconds)
+} frecency_entry_t;
+
+struct frecency_s {
+    alloc_t* mem;
+    char* fname;              // file the acceptances are appended to (or NULL)
+    frecency_entry_t* table;  // open addressing on `key`
+    ssize_t table_len;        // a power of 2 (or 0)
+    ssize_t count;
+    ssize_t lines;  // lines in the file (compacted once much larger than `count`)
+};
+
+ic_private frecency_t* frecency_new(alloc_t* mem) {
+    frecency_t* fr = mem_zalloc_tp(mem, frecency_t);
+    if (fr == NULL)
+        return NULL;
+    fr->mem = mem;
+    return fr;
+}
+
+static void frecency_clear(frecency_t* fr) {
+    mem_free(fr->mem, fr->table);
+    fr->table = NULL;
+    fr->table_len = 0;
+    fr->count = 0;
+    fr->lines = 0;
+}
+
+ic_private void frecency_free(frecency_t* fr) {
+    if (fr == NULL)
+        return;
+    frecency_clear(fr);
+    mem_free(fr->mem, fr->fname);
+    mem_free(fr->mem, fr);
+}
+
+ic_private bool frecency_is_empty(const frecency_t* fr) {
+    return (fr == NULL || fr->count == 0);
+}
+
+static uint64_t frecency_hash(uint64_t h, const char* s, ssize_t len) {
+    for (ssize_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)s[i]) * IC_FRECENCY_FNV_PRIME;
+    }
+    return h;
+}
+
+static bool frecency_is_space(char c) {
+    return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+ic_private uint64_t frecency_context(const char* input, ssize_t pos) {
+    if (input == NULL)
+        return 0;
+    ssize_t start = 0;
+    while (frecency_is_space(input[start])) {
+        start++;
+    }
+    ssize_t end = start;
+    while (input[end] != 0 && !frecency_is_space(input[end])) {
+        end++;
+    }
+    if (pos <= end)
+        return 0;  // completing the first word itself
+    const uint64_t h = frecency_hash(IC_FRECENCY_FNV_OFFSET, input + start, end - start);
+    return (h == 0 ? 1 : h);
+}
+
+static uint64_t frecency_key(uint64_t context, const char* replacement) {
+    uint64_t h = frecency_hash(IC_FRECENCY_FNV_OFFSET ^ context, replacement,
+                               ic_strlen(replacement));
+    return (h == 0 ? 1 : h);
+}
+
+static frecency_entry_t* frecency_find(const frecency_t* fr, uint64_t key) {
+    if (fr->table_len == 0)
+        return NULL;
+    const ssize_t mask = fr->table_len - 1;
+    ssize_t i = (ssize_t)(key & (uint64_t)mask);
+    while (fr->table[i].key != 0) {
+        if (fr->table[i].key == key)
+            return &fr->table[i];
+        i = (i + 1) & mask;
+    }
+    return &fr->table[i];  // the empty slot for `key`
+}
+
+static int frecency_entry_compare(const void* p1, const void* p2) {
+    const frecency_entry_t* e1 = (const frecency_entry_t*)p1;
+    const frecency_entry_t* e2 = (const frecency_entry_t*)p2;
+    if (e1->last != e2->last)
+        return (e1->last > e2->last ? -1 : 1);  // most recent first
+    return (e1->count > e2->count ? -1 : (e1->count < e2->count ? 1 : 0));
+}
+
+// rehash into a table of `len` entries, keeping only the `keep` most recent entries
+static bool frecency_resize(frecency_t* fr, ssize_t len, ssize_t keep) {
+    frecency_entry_t* entries = mem_malloc_tp_n(fr->mem, frecency_entry_t, fr->count + 1);
+    frecency_entry_t* table = mem_zalloc_tp_n(fr->mem, frecency_entry_t, len);
+    if (entries == NULL || table == NULL) {
+        mem_free(fr->mem, entries);
+        mem_free(fr->mem, table);
+        return false;
+    }
+    ssize_t n = 0;
+    for (ssize_t i = 0; i < fr->table_len; i++) {
+        if (fr->table[i].key != 0)
+            entries[n++] = fr->table[i];
+    }
+    if (keep < n) {
+        qsort(entries, to_size_t(n), sizeof(entries[0]), &frecency_entry_compare);
+        n = keep;
+    }
+    mem_free(fr->mem, fr->table);
+    fr->table = table;
+    fr->table_len = len;
+    fr->count = n;
+    for (ssize_t i = 0; i < n; i++) {
+        *frecency_find(fr, entries[i].key) = entries[i];
+    }
+    mem_free(fr->mem, entries);
+    return true;
+}
+
+static void frecency_add(frecency_t* fr, uint64_t key, uint32_t count, long long last) {
+    if (fr->count >= IC_FRECENCY_MAX) {
+        frecency_resize(fr, fr->table_len, IC_FRECENCY_MAX / 2);
+    }
+    if (2 * (fr->count + 1) > fr->table_len) {
+        if (!frecency_resize(fr, (fr->table_len == 0 ? 64 : 2 * fr->table_len), fr->count))
+            return;
+    }
+    frecency_entry_t* entry = frecency_find(fr, key);
+    if (entry->key == 0) {
+        entry->key = key;
+        fr->count++;
+    }
+    entry->count += count;
+    if (last > entry->last)
+        entry->last = last;
+}
+
+ic_private long frecency_score(const frecency_t* fr, uint64_t context, const char* replacement,
+                               long long now) {
+    if (fr == NULL || fr->count == 0 || replacement == NULL)
+        return 0;
+    const frecency_entry_t* entry = frecency_find(fr, frecency_key(context, replacement));
+    if (entry == NULL || entry->key == 0)
+        return 0;
+    // weigh the count by the age of the last acceptance
+    const long long age = now - entry->last;
+    const long day = 24 * 60 * 60;
+    long weight = 10;
+    if (age < 4 * day)
+        weight = 100;
+    else if (age < 14 * day)
+        weight = 70;
+    else if (age < 31 * day)
+        weight = 50;
+    else if (age < 90 * day)
+        weight = 30;
+    return (long)entry->count * weight;
+}
+
+//-------------------------------------------------------------
+// Persistence
+// Each acceptance is appended to the file as a line with the
+// key (in hex), a count, and the time. Loading adds up the
+// lines, and once the file has many more lines than entries it
+// is rewritten with a single line per entry. The file is only
+// readable by the user (as it reveals what the user typed).
+//-------------------------------------------------------------
+
+// open `fname` for writing (or appending), creating it as private
+static FILE* frecency_fopen(const char* fname, bool append) {
+#if defined(_WIN32)
+    return fopen(fname, (append ? "a" : "w"));
+#else
+    const int fd =
+        open(fname, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return NULL;
+    FILE* f = fdopen(fd, (append ? "a" : "w"));
+    if (f == NULL)
+        close(fd);
+    return f;
+#endif
+}
+
+static void frecency_write_entry(FILE* f, uint64_t key, uint32_t count, long long last) {
+    fprintf(f, "%016llx %lu %lld\n", (unsigned long long)key, (unsigned long)count, last);
+}
+
+static void frecency_compact(frecency_t* fr) {
+    const ssize_t len = ic_strlen(fr->fname) + 5;
+    char* tmp = mem_malloc_tp_n(fr->mem, char, len);
+    if (tmp == NULL)
+        return;
+    snprintf(tmp, to_size_t(len), "%s.tmp", fr->fname);
+    remove(tmp);  // a stale one may have been created with other permissions
+    FILE* f = frecency_fopen(tmp, false);
+    if (f != NULL) {
+        for (ssize_t i = 0; i < fr->table_len; i++) {
+            const frecency_entry_t* e = &fr->table[i];
+            if (e->key != 0)
+                frecency_write_entry(f, e->key, e->count, e->last);
+        }
+        if (fclose(f) == 0 && rename(tmp, fr->fname) == 0) {
+            fr->lines = fr->count;
+        } else {
+            remove(tmp);
+        }
+    }
+    mem_free(fr->mem, tmp);
+}
+
+ic_private void frecency_load_from(frecency_t* fr, const char* fname) {
+    if (fr == NULL)
+        return;
+    frecency_clear(fr);
+    mem_free(fr->mem, fr->fname);
+    fr->fname = NULL;
+    if (fname == NULL)
+        return;
+    const ssize_t len = ic_strlen(fname) + ssizeof(IC_FRECENCY_EXT);
+    fr->fname = mem_malloc_tp_n(fr->mem, char, len);
+    if (fr->fname == NULL)
+        return;
+    snprintf(fr->fname, to_size_t(len), "%s%s", fname, IC_FRECENCY_EXT);
+    FILE* f = fopen(fr->fname, "r");
+    if (f == NULL)
+        return;
+    unsigned long long key;
+    unsigned long count;
+    long long last;
+    while (fscanf(f, "%llx %lu %lld", &key, &count, &last) == 3) {
+        if (key != 0 && count > 0)
+            frecency_add(fr, (uint64_t)key, (uint32_t)count, last);
+        fr->lines++;
+    }
+    fclose(f);
+    if (fr->lines > 2 * fr->count + 64) {
+        frecency_compact(fr);
+    }
+}
+
+ic_private void frecency_record(frecency_t* fr, uint64_t context, const char* replacement) {
+    if (fr == NULL || replacement == NULL)
+        return;
+    const uint64_t key = frecency_key(context, replacement);
+    const long long now = (long long)time(NULL);
+    frecency_add(fr, key, 1, now);
+    if (fr->fname == NULL)
+        return;
+    FILE* f = frecency_fopen(fr->fname, true);
+    if (f == NULL)
+        return;
+    frecency_write_entry(f, key, 1, now);
+    fclose(f);
+    fr->lines++;
+}
@@ -0,0 +1,42 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#pragma once
+#ifndef IC_FRECENCY_H
+#define IC_FRECENCY_H
+
+#include "common.h"
+
+//-------------------------------------------------------------
+// Completion ranking
+// Counts how often, and how recently, a completion is accepted
+// in a context (the command word of the input). Entries are kept
+// in a hash table on a 64-bit hash of the context and the
+// replacement, so a score lookup takes constant time. Every
+// acceptance is appended to a file next to the history file.
+//-------------------------------------------------------------
+
+struct frecency_s;
+typedef struct frecency_s frecency_t;
+
+ic_private frecency_t* frecency_new(alloc_t* mem);
+ic_private void frecency_free(frecency_t* fr);  // fr can be NULL
+ic_private bool frecency_is_empty(const frecency_t* fr);
+
+// load (and persist to) `fname` (or only keep them in memory if NULL)
+ic_private void frecency_load_from(frecency_t* fr, const char* fname);
+
+// the context of completing at `pos` in `input`: a hash of the first word if `pos` is past it
+ic_private uint64_t frecency_context(const char* input, ssize_t pos);
+
+ic_private void frecency_record(frecency_t* fr, uint64_t context, const char* replacement);
+
+// the score of `replacement` in `context` at time `now` (0 if it was never accepted)
+ic_private long frecency_score(const frecency_t* fr, uint64_t context, const char* replacement,
+                               long long now);
+
+#endif  // IC_FRECENCY_H
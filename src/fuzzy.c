@@ -0,0 +1,215 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#include "fuzzy.h"
+
+#include <string.h>
+
+#include "common.h"
+#include "isocline.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__)) && !defined(IC_NO_SIMD)
+#define IC_FUZZY_SSE2
+#include <emmintrin.h>
+#endif
+
+//-------------------------------------------------------------
+// Subsequence prefilter
+// Most candidates do not match at all, so we first check if the
+// pattern is a subsequence. With SSE2, short candidates are tested
+// on position bit masks of each pattern character, and longer ones
+// by searching each pattern character in turn 16 bytes at a time.
+//-------------------------------------------------------------
+
+static inline char fuzzy_fold(char c) {
+    return ((c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c);
+}
+
+static inline bool fuzzy_eq(char c, char pc) {
+    return (fuzzy_fold(c) == pc);
+}
+
+// case mask of a folded pattern character: `(c | mask) == pc` matches both cases of a letter
+static inline char fuzzy_case_mask(char pc) {
+    return ((pc >= 'a' && pc <= 'z') ? (char)0x20 : (char)0);
+}
+
+#ifdef IC_FUZZY_SSE2
+// find the first index `>= i` where `s[index]` equals the folded character `pc` (ignoring case),
+// 16 bytes at a time; returns `len` if not found.
+static ssize_t fuzzy_find_sse2(const char* s, ssize_t i, ssize_t len, char pc, char mask) {
+    const __m128i vpc = _mm_set1_epi8(pc);
+    const __m128i vmask = _mm_set1_epi8(mask);
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+        const int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(v, vmask), vpc));
+        if (bits != 0) {
+            return i + __builtin_ctz((unsigned)bits);
+        }
+    }
+    for (; i < len; i++) {
+        if ((char)(s[i] | mask) == pc)
+            return i;
+    }
+    return len;
+}
+
+// subsequence test for candidates of at most 32 bytes: compute the positions of each
+// pattern character as a bit mask and check (without branches) that they occur in order.
+static bool fuzzy_is_match_short(const char* pattern, ssize_t plen, const char* s, ssize_t slen) {
+    __m128i lo;
+    __m128i hi;
+    int hi_shift;
+    if (slen >= 16) {
+        // two (possibly overlapping) loads that stay inside the candidate
+        lo = _mm_loadu_si128((const __m128i*)(const void*)s);
+        hi = _mm_loadu_si128((const __m128i*)(const void*)(s + slen - 16));
+        hi_shift = (int)(slen - 16);
+    } else {
+        char buf[16];
+        memset(buf, 0, sizeof(buf));
+        memcpy(buf, s, to_size_t(slen));
+        lo = _mm_loadu_si128((const __m128i*)(const void*)buf);
+        hi = lo;
+        hi_shift = 0;
+    }
+    uint64_t allowed = (((uint64_t)1 << slen) - 1);
+    bool ok = true;
+    for (ssize_t k = 0; k < plen; k++) {
+        const char pc = fuzzy_fold(pattern[k]);
+        const __m128i vpc = _mm_set1_epi8(pc);
+        const __m128i vmask = _mm_set1_epi8(fuzzy_case_mask(pc));
+        const uint64_t mlo =
+            (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(lo, vmask), vpc));
+        const uint64_t mhi =
+            (uint64_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(hi, vmask), vpc));
+        const uint64_t m = (mlo | (mhi << hi_shift)) & allowed;
+        ok = ok && (m != 0);
+        const int pos = __builtin_ctzll(m | ((uint64_t)1 << 32));
+        allowed &= ~(((uint64_t)2 << pos) - 1);  // only positions after this match
+    }
+    return ok;
+}
+#endif
+
+ic_private bool fuzzy_is_match(const char* pattern, ssize_t plen, const char* s, ssize_t slen) {
+    if (plen > slen)
+        return false;
+#ifdef IC_FUZZY_SSE2
+    if (slen <= 32)
+        return fuzzy_is_match_short(pattern, plen, s, slen);
+#endif
+    ssize_t i = 0;
+    for (ssize_t k = 0; k < plen; k++, i++) {
+        const char pc = fuzzy_fold(pattern[k]);
+        const char mask = fuzzy_case_mask(pc);
+#ifdef IC_FUZZY_SSE2
+        if (slen - i >= 32) {
+            i = fuzzy_find_sse2(s, i, slen, pc, mask);
+        } else
+#endif
+        {
+            while (i < slen && (char)(s[i] | mask) != pc) {
+                i++;
+            }
+        }
+        if (i >= slen)
+            return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------
+// Scoring
+// We find the shortest window that ends at the first complete
+// match (scanning back from its end), and score the matches in
+// that window: every match scores, with bonuses for matching at
+// the start, at a word boundary, consecutively, or with the same
+// case; gaps are penalized.
+//-------------------------------------------------------------
+
+#define FUZZY_SCORE_MATCH (16)
+#define FUZZY_BONUS_START (12)
+#define FUZZY_BONUS_BOUNDARY (8)
+#define FUZZY_BONUS_CONSECUTIVE (6)
+#define FUZZY_BONUS_CASE (1)
+#define FUZZY_PENALTY_GAP_START (3)
+#define FUZZY_PENALTY_GAP (1)
+#define FUZZY_PENALTY_LEADING_MAX (10)
+
+static bool fuzzy_is_boundary(char prev, char c) {
+    if (strchr(" -_./\\:,;=", prev) != NULL)
+        return true;
+    if (prev >= 'a' && prev <= 'z' && c >= 'A' && c <= 'Z')
+        return true;  // camelCase
+    return (!(prev >= '0' && prev <= '9') && (c >= '0' && c <= '9'));
+}
+
+ic_private long fuzzy_score(const char* pattern, ssize_t plen, const char* s, ssize_t slen) {
+    if (plen <= 0)
+        return 0;
+    if (!fuzzy_is_match(pattern, plen, s, slen))
+        return -1;
+
+    // end of the first complete match
+    ssize_t end = -1;
+    for (ssize_t i = 0, k = 0; i < slen; i++) {
+        if (fuzzy_eq(s[i], fuzzy_fold(pattern[k])) && ++k == plen) {
+            end = i;
+            break;
+        }
+    }
+    if (end < 0)
+        return -1;
+    // shortest window ending there
+    ssize_t start = end;
+    for (ssize_t i = end, k = plen - 1; i >= 0; i--) {
+        if (fuzzy_eq(s[i], fuzzy_fold(pattern[k]))) {
+            if (k == 0) {
+                start = i;
+                break;
+            }
+            k--;
+        }
+    }
+
+    long score = 0;
+    bool consecutive = false;
+    ssize_t k = 0;
+    for (ssize_t i = start; i <= end && k < plen; i++) {
+        if (fuzzy_eq(s[i], fuzzy_fold(pattern[k]))) {
+            long sc = FUZZY_SCORE_MATCH;
+            if (i == 0) {
+                sc += FUZZY_BONUS_START;
+            } else if (fuzzy_is_boundary(s[i - 1], s[i])) {
+                sc += FUZZY_BONUS_BOUNDARY;
+            }
+            if (consecutive)
+                sc += FUZZY_BONUS_CONSECUTIVE;
+            if (s[i] == pattern[k])
+                sc += FUZZY_BONUS_CASE;
+            score += sc;
+            consecutive = true;
+            k++;
+        } else {
+            score -= (consecutive ? FUZZY_PENALTY_GAP_START : FUZZY_PENALTY_GAP);
+            consecutive = false;
+        }
+    }
+    score -= (start < FUZZY_PENALTY_LEADING_MAX ? (long)start : FUZZY_PENALTY_LEADING_MAX);
+    return (score < 0 ? 0 : score);
+}
+
+//-------------------------------------------------------------
+// Public
+//-------------------------------------------------------------
+
+ic_public long ic_fuzzy_score(const char* pattern, const char* candidate) {
+    if (pattern == NULL || candidate == NULL)
+        return -1;
+    return fuzzy_score(pattern, ic_strlen(pattern), candidate, ic_strlen(candidate));
+}
@@ -0,0 +1,24 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#pragma once
+#ifndef IC_FUZZY_H
+#define IC_FUZZY_H
+
+#include "common.h"
+
+//-------------------------------------------------------------
+// Fuzzy matching
+// A pattern matches a candidate if its characters occur in order
+// (ignoring ascii case) in the candidate. Scores are >= 0 for a
+// match (higher is better) and -1 otherwise.
+//-------------------------------------------------------------
+
+ic_private bool fuzzy_is_match(const char* pattern, ssize_t plen, const char* s, ssize_t slen);
+ic_private long fuzzy_score(const char* pattern, ssize_t plen, const char* s, ssize_t slen);
+
+#endif  // IC_FUZZY_H
@@ -24,6 +24,8 @@
 #include "isocline/completers.c"
 #include "isocline/completions.c"
 #include "isocline/editline.c"
+#include "isocline/frecency.c"
+#include "isocline/fuzzy.c"
 #include "isocline/highlight.c"
 #include "isocline/history.c"
 #include "isocline/isocline_env.c"
@@ -32,6 +34,7 @@
 #include "isocline/isocline_print.c"
 #include "isocline/isocline_readline.c"
 #include "isocline/isocline_terminal.c"
+#include "isocline/spell.c"
 #include "isocline/stringbuf.c"
 #include "isocline/term.c"
 #include "isocline/tty.c"
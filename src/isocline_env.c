@@ -75,6 +75,9 @@ static ic_env_t* ic_env_create(ic_malloc_fun_t* _malloc, ic_realloc_fun_t* _real
     env->bbcode = bbcode_new(env->mem, env->term);
 
     env->hint_delay = 400;
+    env->fname_timeout = 1000;
+    env->glob_depth = 16;
+    env->glob_entries = 100000;
 
     if (env->tty == NULL || env->term == NULL || env->completions == NULL || env->history == NULL ||
         env->bbcode == NULL || !term_is_interactive(env->term)) {
@@ -112,6 +115,9 @@ static void ic_env_free(ic_env_t* env) {
     }
     history_free(env->history);
     completions_free(env->completions);
+    spell_dict_free(env->spell_dict);
+    dircache_free();
+    cmd_index_free();
     bbcode_free(env->bbcode);
     term_free(env->term);
     tty_free(env->tty);
@@ -11,6 +11,7 @@
 -----------------------------------------------------------------------------*/
 
 #include "common.h"
+#include "completions.h"
 #include "env.h"
 #include "env_internal.h"
 
@@ -74,6 +75,7 @@ ic_public void ic_set_history(const char* fname, long max_entries) {
     if (env == NULL)
         return;
     history_load_from(env->history, fname, max_entries);
+    completions_set_rank_file(env->completions, fname);
 }
 
 ic_public void ic_history_remove_last(void) {
@@ -134,6 +136,60 @@ ic_public bool ic_enable_hint(bool enable) {
     return !prev;
 }
 
+ic_public bool ic_enable_completion_prefetch(bool enable) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    bool prev = env->prefetch;
+    env->prefetch = enable;
+    return prev;
+}
+
+ic_public bool ic_enable_filename_cache(bool enable) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    bool prev = env->no_dircache;
+    env->no_dircache = !enable;
+    if (!enable) {
+        dircache_free();
+    }
+    return !prev;
+}
+
+ic_public long ic_set_filename_threads(long threads, long root_timeout_ms) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return 0;
+    long prev = env->fname_threads;
+    env->fname_threads = (threads < 0 ? 0 : (threads > 16 ? 16 : threads));
+    if (root_timeout_ms > 0) {
+        env->fname_timeout = root_timeout_ms;
+    }
+    return prev;
+}
+
+ic_public long ic_set_filename_glob_limits(long max_depth, long max_entries) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return 0;
+    long prev = env->glob_depth;
+    env->glob_depth = (max_depth < 0 ? 0 : max_depth);
+    if (max_entries > 0) {
+        env->glob_entries = max_entries;
+    }
+    return prev;
+}
+
+ic_public bool ic_enable_fuzzy(bool enable) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    bool prev = env->fuzzy;
+    env->fuzzy = enable;
+    return prev;
+}
+
 ic_public bool ic_enable_spell_correct(bool enable) {
     ic_env_t* env = ic_get_env();
     if (env == NULL)
@@ -143,6 +199,35 @@ ic_public bool ic_enable_spell_correct(bool enable) {
     return prev;
 }
 
+ic_public bool ic_set_spell_dictionary(const char** words) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return false;
+    spell_dict_free(env->spell_dict);
+    env->spell_dict = NULL;
+    if (words == NULL)
+        return true;
+    spell_dict_t* sd = spell_dict_new(env->mem);
+    if (sd == NULL)
+        return false;
+    for (const char** w = words; *w != NULL; w++) {
+        if ((*w)[0] != 0 && !spell_dict_add(sd, *w)) {
+            spell_dict_free(sd);
+            return false;
+        }
+    }
+    env->spell_dict = sd;
+    return true;
+}
+
+ic_public void ic_set_completion_budget(long hint_ms, long complete_ms) {
+    ic_env_t* env = ic_get_env();
+    if (env == NULL)
+        return;
+    env->hint_budget = (hint_ms < 0 ? 0 : hint_ms);
+    env->complete_budget = (complete_ms < 0 ? 0 : complete_ms);
+}
+
 ic_public long ic_set_hint_delay(long delay_ms) {
     ic_env_t* env = ic_get_env();
     if (env == NULL)
@@ -154,6 +154,7 @@ ic_public char* ic_readline_ex(const char* prompt_text, ic_completer_fun_t* comp
     ic_completer_fun_t* prev_completer;
     void* prev_completer_arg;
     completions_get_completer(env->completions, &prev_completer, &prev_completer_arg);
+    bool prev_monotonic = completions_is_monotonic(env->completions);
     ic_highlight_fun_t* prev_highlighter = env->highlighter;
     void* prev_highlighter_arg = env->highlighter_arg;
     if (completer != NULL) {
@@ -164,6 +165,7 @@ ic_public char* ic_readline_ex(const char* prompt_text, ic_completer_fun_t* comp
     }
     char* res = ic_readline(prompt_text, "");
     ic_set_default_completer(prev_completer, prev_completer_arg);
+    completions_set_monotonic(env->completions, prev_monotonic);
     ic_set_default_highlighter(prev_highlighter, prev_highlighter_arg);
     return res;
 }
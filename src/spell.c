@@ -0,0 +1,300 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#include "spell.h"
+
+#include <string.h>
+
+#include "common.h"
+
+//-------------------------------------------------------------
+// Bounded edit distance
+//-------------------------------------------------------------
+
+static inline uint8_t spell_fold(char c) {
+    return (uint8_t)((c >= 'A' && c <= 'Z') ? (c - 'A' + 'a') : c);
+}
+
+ic_private bool spell_matcher_init(spell_matcher_t* sm, alloc_t* mem, const char* word,
+                                   ssize_t len) {
+    memset(sm, 0, sizeof(*sm));
+    sm->mem = mem;
+    if (word == NULL || len < 0)
+        return false;
+    sm->len = len;
+    sm->blocks = (len + 63) / 64;
+    if (sm->blocks <= 1) {
+        sm->blocks = 1;
+        sm->peq = sm->peq1;
+        sm->pv = &sm->pv1;
+        sm->mv = &sm->mv1;
+    } else {
+        sm->peq = mem_zalloc_tp_n(mem, uint64_t, 256 * sm->blocks);
+        sm->pv = mem_malloc_tp_n(mem, uint64_t, sm->blocks);
+        sm->mv = mem_malloc_tp_n(mem, uint64_t, sm->blocks);
+        if (sm->peq == NULL || sm->pv == NULL || sm->mv == NULL) {
+            spell_matcher_done(sm);
+            return false;
+        }
+    }
+    for (ssize_t i = 0; i < len; i++) {
+        sm->peq[(spell_fold(word[i]) * sm->blocks) + (i / 64)] |= (uint64_t)1 << (i % 64);
+    }
+    return true;
+}
+
+ic_private void spell_matcher_done(spell_matcher_t* sm) {
+    if (sm->peq != sm->peq1) {
+        mem_free(sm->mem, sm->peq);
+        mem_free(sm->mem, sm->pv);
+        mem_free(sm->mem, sm->mv);
+    }
+    memset(sm, 0, sizeof(*sm));
+}
+
+// Advance one 64-row block by a column for the match mask `eq`, given the horizontal
+// delta `hin` (-1, 0, or 1) entering at its top; returns the delta leaving at row `bit`.
+static inline int spell_block(uint64_t* pv, uint64_t* mv, uint64_t eq, int hin, uint64_t bit) {
+    const uint64_t hneg = (hin < 0 ? (uint64_t)1 : 0);
+    const uint64_t xv = eq | *mv;
+    eq |= hneg;
+    const uint64_t xh = (((eq & *pv) + *pv) ^ *pv) | eq;
+    uint64_t ph = *mv | ~(xh | *pv);
+    uint64_t mh = *pv & xh;
+    const int hout = ((ph & bit) != 0 ? 1 : ((mh & bit) != 0 ? -1 : 0));
+    ph = (ph << 1) | (hin > 0 ? (uint64_t)1 : 0);
+    mh = (mh << 1) | hneg;
+    *pv = mh | ~(xv | ph);
+    *mv = ph & xv;
+    return hout;
+}
+
+ic_private ssize_t spell_distance(spell_matcher_t* sm, const char* s, ssize_t len, ssize_t max) {
+    if (s == NULL || len < 0)
+        return max + 1;
+    const ssize_t m = sm->len;
+    if (m - len > max || len - m > max)
+        return max + 1;
+    if (m == 0)
+        return len;
+    const ssize_t blocks = sm->blocks;
+    const uint64_t top = (uint64_t)1 << 63;
+    const uint64_t last = (uint64_t)1 << ((m - 1) % 64);
+    for (ssize_t b = 0; b < blocks; b++) {
+        sm->pv[b] = ~(uint64_t)0;
+        sm->mv[b] = 0;
+    }
+    ssize_t score = m;  // distance of the word to the prefix of `s` seen so far
+    for (ssize_t j = 0; j < len; j++) {
+        const uint64_t* eq = sm->peq + (spell_fold(s[j]) * blocks);
+        int h = 1;  // the top row is the distance to the empty word
+        for (ssize_t b = 0; b < blocks; b++) {
+            h = spell_block(&sm->pv[b], &sm->mv[b], eq[b], h, (b == blocks - 1 ? last : top));
+        }
+        score += h;
+        // each remaining character lowers the distance by at most one
+        if (score - (len - j - 1) > max)
+            return max + 1;
+    }
+    return (score > max ? max + 1 : score);
+}
+
+ic_private ssize_t spell_threshold(ssize_t len1, ssize_t len2) {
+    ssize_t max_len = (len1 > len2 ? len1 : len2);
+    if (max_len <= 4)
+        return 1;
+    if (max_len <= 6)
+        return 2;
+    return max_len / 2;
+}
+
+//-------------------------------------------------------------
+// Correction dictionary
+//-------------------------------------------------------------
+
+typedef struct spell_node_s {
+    ssize_t word;     // offset of the word in `chars`
+    ssize_t len;      // length of the word
+    ssize_t edge;     // distance to the parent
+    ssize_t maxedge;  // largest `edge` of the children
+    ssize_t child;    // first child (or -1)
+    ssize_t next;     // next sibling (or -1)
+} spell_node_t;
+
+struct spell_dict_s {
+    alloc_t* mem;
+    spell_node_t* nodes;  // nodes[0] is the root
+    ssize_t count;
+    ssize_t capacity;
+    char* chars;  // all words, 0 terminated
+    ssize_t chars_len;
+    ssize_t chars_capacity;
+    ssize_t* stack;  // lookup stack (reused)
+    ssize_t stack_capacity;
+};
+
+ic_private spell_dict_t* spell_dict_new(alloc_t* mem) {
+    spell_dict_t* sd = mem_zalloc_tp(mem, spell_dict_t);
+    if (sd == NULL)
+        return NULL;
+    sd->mem = mem;
+    return sd;
+}
+
+ic_private void spell_dict_free(spell_dict_t* sd) {
+    if (sd == NULL)
+        return;
+    mem_free(sd->mem, sd->nodes);
+    mem_free(sd->mem, sd->chars);
+    mem_free(sd->mem, sd->stack);
+    mem_free(sd->mem, sd);
+}
+
+static const char* spell_dict_word(spell_dict_t* sd, const spell_node_t* node) {
+    return sd->chars + node->word;
+}
+
+static ssize_t spell_dict_push_node(spell_dict_t* sd, const char* word, ssize_t len, ssize_t edge) {
+    if (sd->count >= sd->capacity) {
+        ssize_t newcap = (sd->capacity <= 0 ? 64 : 2 * sd->capacity);
+        spell_node_t* nodes = mem_realloc_tp(sd->mem, spell_node_t, sd->nodes, newcap);
+        if (nodes == NULL)
+            return -1;
+        sd->nodes = nodes;
+        sd->capacity = newcap;
+    }
+    if (sd->chars_len + len + 1 > sd->chars_capacity) {
+        ssize_t newcap = (sd->chars_capacity <= 0 ? 1024 : 2 * sd->chars_capacity);
+        while (newcap < sd->chars_len + len + 1) {
+            newcap *= 2;
+        }
+        char* chars = mem_realloc_tp(sd->mem, char, sd->chars, newcap);
+        if (chars == NULL)
+            return -1;
+        sd->chars = chars;
+        sd->chars_capacity = newcap;
+    }
+    spell_node_t* node = &sd->nodes[sd->count];
+    node->word = sd->chars_len;
+    node->len = len;
+    node->edge = edge;
+    node->maxedge = 0;
+    node->child = -1;
+    node->next = -1;
+    ic_memcpy(sd->chars + sd->chars_len, word, len);
+    sd->chars[sd->chars_len + len] = 0;
+    sd->chars_len += len + 1;
+    return sd->count++;
+}
+
+ic_private bool spell_dict_add(spell_dict_t* sd, const char* word) {
+    if (sd == NULL || word == NULL || word[0] == 0)
+        return false;
+    const ssize_t len = ic_strlen(word);
+    if (sd->count == 0)
+        return (spell_dict_push_node(sd, word, len, 0) >= 0);
+
+    spell_matcher_t matcher;
+    if (!spell_matcher_init(&matcher, sd->mem, word, len))
+        return false;
+    bool ok = true;
+    ssize_t cur = 0;
+    while (true) {
+        spell_node_t* node = &sd->nodes[cur];
+        const ssize_t d =
+            spell_distance(&matcher, spell_dict_word(sd, node), node->len, INTPTR_MAX - 1);
+        if (d == 0)
+            break;  // already present (ignoring case)
+        ssize_t child = node->child;
+        while (child >= 0 && sd->nodes[child].edge != d) {
+            child = sd->nodes[child].next;
+        }
+        if (child >= 0) {
+            cur = child;
+            continue;
+        }
+        const ssize_t idx = spell_dict_push_node(sd, word, len, d);
+        if (idx < 0) {
+            ok = false;
+            break;
+        }
+        node = &sd->nodes[cur];  // nodes may have moved
+        sd->nodes[idx].next = node->child;
+        node->child = idx;
+        if (d > node->maxedge)
+            node->maxedge = d;
+        break;
+    }
+    spell_matcher_done(&matcher);
+    return ok;
+}
+
+static bool spell_dict_stack_push(spell_dict_t* sd, ssize_t* top, ssize_t idx) {
+    if (*top >= sd->stack_capacity) {
+        ssize_t newcap = (sd->stack_capacity <= 0 ? 64 : 2 * sd->stack_capacity);
+        ssize_t* stack = mem_realloc_tp(sd->mem, ssize_t, sd->stack, newcap);
+        if (stack == NULL)
+            return false;
+        sd->stack = stack;
+        sd->stack_capacity = newcap;
+    }
+    sd->stack[(*top)++] = idx;
+    return true;
+}
+
+ic_private const char* spell_dict_nearest(spell_dict_t* sd, const char* word, ssize_t len,
+                                          ssize_t* distance) {
+    if (sd == NULL || sd->count == 0 || word == NULL || len <= 0)
+        return NULL;
+
+    // the search radius: longer words have a larger threshold, but are also further away
+    ssize_t radius = spell_threshold(len, len);
+    while (spell_threshold(len, len + radius) > radius) {
+        radius = spell_threshold(len, len + radius);
+    }
+
+    spell_matcher_t matcher;
+    if (!spell_matcher_init(&matcher, sd->mem, word, len))
+        return NULL;
+    ssize_t best = -1;
+    ssize_t best_distance = radius + 1;
+    ssize_t best_len_diff = INTPTR_MAX;
+    ssize_t top = 0;
+    spell_dict_stack_push(sd, &top, 0);
+    while (top > 0) {
+        const spell_node_t* node = &sd->nodes[sd->stack[--top]];
+        // the exact distance is only needed if this node or one of its children can be in range
+        const ssize_t d = spell_distance(&matcher, spell_dict_word(sd, node), node->len,
+                                         radius + node->maxedge);
+        if (d <= radius && d <= spell_threshold(len, node->len)) {
+            const ssize_t len_diff = (node->len > len ? node->len - len : len - node->len);
+            if (d < best_distance || (d == best_distance && len_diff < best_len_diff) ||
+                (d == best_distance && len_diff == best_len_diff && best >= 0 &&
+                 strcmp(spell_dict_word(sd, node), spell_dict_word(sd, &sd->nodes[best])) < 0)) {
+                best = (node - sd->nodes);
+                best_distance = d;
+                best_len_diff = len_diff;
+                radius = d;  // keep equal distances for the length preference
+            }
+        }
+        if (d > radius + node->maxedge)
+            continue;
+        for (ssize_t child = node->child; child >= 0; child = sd->nodes[child].next) {
+            const ssize_t edge = sd->nodes[child].edge;
+            if (edge >= d - radius && edge <= d + radius) {
+                if (!spell_dict_stack_push(sd, &top, child))
+                    break;
+            }
+        }
+    }
+    spell_matcher_done(&matcher);
+    if (best < 0)
+        return NULL;
+    if (distance != NULL)
+        *distance = best_distance;
+    return spell_dict_word(sd, &sd->nodes[best]);
+}
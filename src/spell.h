@@ -0,0 +1,64 @@
+/* ----------------------------------------------------------------------------
+  Copyright (c) 2021, Daan Leijen
+  Largely Modified by Caden Finley 2025 for CJ's Shell
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+-----------------------------------------------------------------------------*/
+#pragma once
+#ifndef IC_SPELL_H
+#define IC_SPELL_H
+
+#include "common.h"
+
+//-------------------------------------------------------------
+// Bounded edit distance
+// A matcher preprocesses a word once; its (ascii case-insensitive)
+// Levenshtein distance to many candidates is then computed with the
+// bit-parallel algorithm of Myers and Hyyrö, 64 rows at a time and
+// without allocation, giving up as soon as the distance must exceed
+// the given bound.
+//-------------------------------------------------------------
+
+typedef struct spell_matcher_s {
+    alloc_t* mem;
+    ssize_t len;         // length of the word
+    ssize_t blocks;      // number of 64-bit blocks
+    uint64_t* peq;       // match mask per character and block (`peq[c*blocks + b]`)
+    uint64_t* pv;        // positive vertical deltas per block
+    uint64_t* mv;        // negative vertical deltas per block
+    uint64_t peq1[256];  // inline storage for words of at most 64 bytes
+    uint64_t pv1;
+    uint64_t mv1;
+} spell_matcher_t;
+
+ic_private bool spell_matcher_init(spell_matcher_t* sm, alloc_t* mem, const char* word,
+                                   ssize_t len);
+ic_private void spell_matcher_done(spell_matcher_t* sm);
+
+// returns the distance to `s`, or `max + 1` if it is larger than `max`
+ic_private ssize_t spell_distance(spell_matcher_t* sm, const char* s, ssize_t len, ssize_t max);
+
+// the largest distance at which a word of length `len1` may be corrected to one of length `len2`
+ic_private ssize_t spell_threshold(ssize_t len1, ssize_t len2);
+
+//-------------------------------------------------------------
+// Correction dictionary
+// A BK-tree over all registered words: each child is keyed by
+// its distance to the parent so by the triangle inequality a
+// lookup only descends into children that can be close enough.
+//-------------------------------------------------------------
+
+struct spell_dict_s;
+typedef struct spell_dict_s spell_dict_t;
+
+ic_private spell_dict_t* spell_dict_new(alloc_t* mem);
+ic_private void spell_dict_free(spell_dict_t* sd);  // sd can be NULL
+ic_private bool spell_dict_add(spell_dict_t* sd, const char* word);
+
+// find the closest word within its `spell_threshold`, preferring words of a similar length;
+// returns NULL if there is none. Its distance is stored in `distance` (if not NULL).
+ic_private const char* spell_dict_nearest(spell_dict_t* sd, const char* word, ssize_t len,
+                                          ssize_t* distance);
+
+#endif  // IC_SPELL_H
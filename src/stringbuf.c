@@ -15,6 +15,11 @@
 #include "common.h"
 #include "stringbuf.h"
 
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__)) && !defined(IC_NO_SIMD)
+#define IC_STRINGBUF_SSE2
+#include <emmintrin.h>
+#endif
+
 //-------------------------------------------------------------
 // In place growable utf-8 strings
 //-------------------------------------------------------------
@@ -214,6 +219,49 @@ static ssize_t str_limit_to_length(const char* s, ssize_t n) {
     return i;
 }
 
+//-------------------------------------------------------------
+// String common prefix
+//-------------------------------------------------------------
+
+// length of the longest common prefix of `s` (of length `slen`) and `t` (of length `tlen`),
+// compared 16 (or 8) bytes at a time. The result never ends in the middle of a codepoint.
+ic_private ssize_t str_common_prefix(const char* s, ssize_t slen, const char* t, ssize_t tlen) {
+    if (s == NULL || t == NULL)
+        return 0;
+    const ssize_t n = (slen < tlen ? slen : tlen);
+    ssize_t i = 0;
+#ifdef IC_STRINGBUF_SSE2
+    for (; i + 16 <= n; i += 16) {
+        const __m128i vs = _mm_loadu_si128((const __m128i*)(const void*)(s + i));
+        const __m128i vt = _mm_loadu_si128((const __m128i*)(const void*)(t + i));
+        const int neq = _mm_movemask_epi8(_mm_cmpeq_epi8(vs, vt)) ^ 0xFFFF;
+        if (neq != 0) {
+            i += __builtin_ctz((unsigned)neq);
+            goto found;
+        }
+    }
+#endif
+    for (; i + 8 <= n; i += 8) {
+        uint64_t ws, wt;
+        memcpy(&ws, s + i, 8);
+        memcpy(&wt, t + i, 8);
+        if (ws != wt)
+            break;
+    }
+    while (i < n && s[i] == t[i]) {
+        i++;
+    }
+#ifdef IC_STRINGBUF_SSE2
+found:
+#endif
+    // back up to the start of a codepoint
+    while (i > 0 && ((i < slen && utf8_is_cont((uint8_t)s[i])) ||
+                     (i < tlen && utf8_is_cont((uint8_t)t[i])))) {
+        i--;
+    }
+    return i;
+}
+
 //-------------------------------------------------------------
 // String searching prev/next word, line, ws_word
 //-------------------------------------------------------------
@@ -120,5 +120,6 @@ ic_private ssize_t str_skip_until_fit(const char* s,
                                       ssize_t max_width);  // tail that fits
 ic_private ssize_t str_take_while_fit(const char* s,
                                       ssize_t max_width);  // prefix that fits
+ic_private ssize_t str_common_prefix(const char* s, ssize_t slen, const char* t, ssize_t tlen);
 
 #endif  // IC_STRINGBUF_H
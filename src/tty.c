@@ -295,6 +295,16 @@ ic_private void tty_code_pushback(tty_t* tty, code_t c) {
     tty->push_count++;
 }
 
+ic_private bool tty_has_input(tty_t* tty) {
+    if (tty->push_count > 0 || tty->cpush_count > 0)
+        return true;
+    uint8_t c;
+    if (!tty_readc_noblock(tty, &c, 0))
+        return false;
+    tty_cpush_char(tty, c);  // peeked
+    return true;
+}
+
 //-------------------------------------------------------------
 // low-level character pushback (for escape sequences and windows)
 //-------------------------------------------------------------
@@ -33,6 +33,7 @@ ic_private code_t tty_read(tty_t* tty);
 ic_private bool tty_read_timeout(tty_t* tty, long timeout_ms, code_t* c);
 
 ic_private void tty_code_pushback(tty_t* tty, code_t c);
+ic_private bool tty_has_input(tty_t* tty);  // is a key available without blocking?
 ic_private bool code_is_ascii_char(code_t c, char* chr);
 ic_private bool code_is_unicode(code_t c, unicode_t* uchr);
 ic_private bool code_is_virt_key(code_t c);
@@ -0,0 +1,106 @@
+/* ----------------------------------------------------------------------------
+  This is free software; you can redistribute it and/or modify it
+  under the terms of the MIT License. A copy of the license can be
+  found in the "LICENSE" file at the root of this distribution.
+
+  Create a completion dictionary for `ic_dict_open`.
+
+  > icdict <output> [<input>]
+
+  Every line of the input (or stdin) is a word, optionally followed by a tab
+  and its display, and another tab and its help:
+
+    word[<tab>display[<tab>help]]
+-----------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "isocline.h"
+
+typedef struct entries_s {
+  char**  words;
+  char**  displays;
+  char**  helps;
+  size_t  count;
+  size_t  capacity;
+} entries_t;
+
+static char* copy_field(const char* s, size_t len) {
+  char* p = (char*)malloc(len + 1);
+  if (p == NULL) return NULL;
+  memcpy(p, s, len);
+  p[len] = 0;
+  return p;
+}
+
+// split a line into its fields and add it
+static int add_line(entries_t* es, char* line) {
+  size_t len = strlen(line);
+  while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) line[--len] = 0;
+  if (len == 0) return 1;  // skip empty lines
+  if (es->count + 1 >= es->capacity) {
+    size_t newcap = (es->capacity == 0 ? 1024 : 2 * es->capacity);
+    char** w = (char**)realloc(es->words, newcap * sizeof(char*));
+    if (w != NULL) es->words = w;
+    char** d = (char**)realloc(es->displays, newcap * sizeof(char*));
+    if (d != NULL) es->displays = d;
+    char** h = (char**)realloc(es->helps, newcap * sizeof(char*));
+    if (h != NULL) es->helps = h;
+    if (w == NULL || d == NULL || h == NULL) return 0;
+    es->capacity = newcap;
+  }
+  char* fields[3] = { line, NULL, NULL };
+  for (int i = 1; i < 3; i++) {
+    char* tab = (fields[i-1] == NULL ? NULL : strchr(fields[i-1], '\t'));
+    if (tab == NULL) break;
+    *tab = 0;
+    fields[i] = tab + 1;
+  }
+  es->words[es->count]    = copy_field(fields[0], strlen(fields[0]));
+  es->displays[es->count] = (fields[1] == NULL ? NULL : copy_field(fields[1], strlen(fields[1])));
+  es->helps[es->count]    = (fields[2] == NULL ? NULL : copy_field(fields[2], strlen(fields[2])));
+  if (es->words[es->count] == NULL) return 0;
+  es->count++;
+  es->words[es->count] = NULL;
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s <output> [<input>]\n", argv[0]);
+    return 2;
+  }
+  FILE* in = (argc == 3 ? fopen(argv[2], "r") : stdin);
+  if (in == NULL) {
+    fprintf(stderr, "error: cannot open %s\n", argv[2]);
+    return 1;
+  }
+  entries_t es;
+  memset(&es, 0, sizeof(es));
+  static char buf[65536];
+  int ok = 1;
+  while (ok && fgets(buf, sizeof(buf), in) != NULL) {
+    ok = add_line(&es, buf);
+  }
+  if (in != stdin) fclose(in);
+  if (ok && es.count == 0) {
+    fprintf(stderr, "error: no words in the input\n");
+    ok = 0;
+  }
+  if (ok && !ic_dict_write(argv[1], (const char**)es.words, (const char**)es.displays,
+                           (const char**)es.helps)) {
+    fprintf(stderr, "error: cannot write %s\n", argv[1]);
+    ok = 0;
+  }
+  if (ok) printf("wrote %zu words to %s\n", es.count, argv[1]);
+  for (size_t i = 0; i < es.count; i++) {
+    free(es.words[i]);
+    free(es.displays[i]);
+    free(es.helps[i]);
+  }
+  free(es.words);
+  free(es.displays);
+  free(es.helps);
+  return (ok ? 0 : 1);
+}